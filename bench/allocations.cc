@@ -0,0 +1,159 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+// Counts heap allocations made by the per-keystroke pipeline (suggestion
+// lookup, autocompletion, UTF-8 to UTF-32 conversion, and text rendering) in
+// steady state, when the same keystrokes are typed again. The font is read
+// from the file specified by the ROSE_BENCH_FONT environment variable; text
+// rendering is skipped if the variable is not set.
+// Note: Only the pipeline of the library is covered; the code of the program
+// which prepares and presents frames (with SDL) is not measured.
+//
+#include "common.hh"
+#include "executables_database.hh"
+#include "filesystem.hh"
+#include "rendering_text.hh"
+#include "unicode.hh"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Counting allocator.
+////////////////////////////////////////////////////////////////////////////////
+
+static std::atomic<unsigned long long> n_allocations;
+
+void*
+operator new(std::size_t size) {
+    n_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(auto p = std::malloc((size == 0) ? 1 : size); p != nullptr) {
+        return p;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void
+operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark parameters.
+////////////////////////////////////////////////////////////////////////////////
+
+static constexpr auto n_directories = 20;
+static constexpr auto n_files_per_directory = 500;
+static constexpr auto n_queries = 100;
+
+////////////////////////////////////////////////////////////////////////////////
+// Program entry point.
+////////////////////////////////////////////////////////////////////////////////
+
+int
+main() {
+    // Create a temporary directory.
+    auto root = bench::temporary_directory{};
+    if(root.path.empty()) {
+        return EXIT_FAILURE;
+    }
+
+    // Create the synthetic PATH.
+    auto generator = std::mt19937{42};
+    auto path = bench::create_synthetic_path(
+        root.path, n_directories, n_files_per_directory, generator);
+
+    bench::set_environment(root.path, path);
+
+    // Generate the keystrokes: each query is a prefix of an existing name,
+    // typed one character at a time.
+    auto queries = std::vector<std::u8string>{};
+    for(auto i = 0; i != n_queries; ++i) {
+        auto const& name = path.names[std::uniform_int_distribution<size_t>{
+            0, path.names.size() - 1}(generator)];
+
+        for(auto query = std::u8string{}; auto c : name) {
+            queries.push_back(query += static_cast<char8_t>(c));
+        }
+    }
+
+    // Initialize text rendering context, if possible.
+    auto context = rose::text_rendering_context{};
+    if(auto font_path = std::getenv("ROSE_BENCH_FONT"); font_path != nullptr) {
+        auto fonts = std::vector<std::vector<unsigned char>>{};
+        fonts.push_back(rose::filesystem::read(font_path));
+
+        context = rose::initialize(
+            rose::text_rendering_context_parameters{.fonts = fonts});
+    }
+
+    // Initialize the render target.
+    static constexpr auto w = 1000, h = 32;
+    auto pixels = std::vector<unsigned char>(w * h * 4);
+
+    auto is_successful = true;
+    for(auto mode : {rose::matching_mode::prefix, rose::matching_mode::fuzzy}) {
+        auto database = rose::executables_database{mode};
+
+        // Define the pipeline which is run for each keystroke.
+        auto string = std::u8string{}, completion = std::u8string{};
+        auto text_line = rose::utf32_string_buffer{};
+
+        auto process_keystroke = [&](std::u8string_view query) {
+            database.autocomplete(query, completion);
+
+            string = u8"$ ";
+            database.lookup_suggestions(query, string);
+
+            rose::convert_utf8_to_utf32(string, text_line);
+            if(context) {
+                rose::render(
+                    context,
+                    {.font_size = 16, .dpi = 96, .text_line = text_line},
+                    {.pixels = pixels.data(), .w = w, .h = h});
+            }
+        };
+
+        // Type all keystrokes once, so that all buffers and caches are warm.
+        for(auto const& query : queries) {
+            process_keystroke(query);
+        }
+
+        // Type them again, and count allocations.
+        auto n = n_allocations.load();
+        for(auto const& query : queries) {
+            process_keystroke(query);
+        }
+
+        n = n_allocations.load() - n;
+
+        // Report the results.
+        auto is_prefix = (mode == rose::matching_mode::prefix);
+        std::printf("allocations (%s matching%s): %zu keystrokes, %llu "
+                    "allocations\n",
+                    (is_prefix ? "prefix" : "fuzzy"),
+                    (context ? ", with rendering" : ""), queries.size(), n);
+
+        is_successful = is_successful && (n == 0);
+    }
+
+    if(!is_successful) {
+        std::printf("  FAILED: steady state is not allocation-free\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+// Measures throughput of command initialization, and of sending commands to
+// the executor process through a pipe. The executor is replaced with a thread
+// which parses the packets without launching the commands.
+//
+#include "buffer.hh"
+#include "common.hh"
+#include "execution.hh"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark parameters.
+////////////////////////////////////////////////////////////////////////////////
+
+static constexpr auto n_commands = 200000;
+
+////////////////////////////////////////////////////////////////////////////////
+// Program entry point.
+////////////////////////////////////////////////////////////////////////////////
+
+int
+main() {
+    using namespace rose;
+
+    // Define the command string.
+    auto string = std::u8string_view{
+        u8"firefox --new-window https://example.org/a\\ b --private-window"};
+
+    std::printf("command_framing: %d commands, %zu bytes each\n", n_commands,
+                string.size());
+
+    // Measure command initialization.
+    if(auto command = std::u8string{}; true) {
+        auto t = bench::measure([&] {
+            for(auto i = 0; i != n_commands; ++i) {
+                initialize_command(string, command);
+            }
+        });
+
+        std::printf("  initialization: %.1f ns per command\n",
+                    (t * 1000.0) / n_commands);
+    }
+
+    // Create the pipe.
+    int fds[2] = {};
+    if(pipe2(fds, O_CLOEXEC) == -1) {
+        return EXIT_FAILURE;
+    }
+
+    // Start the thread which parses the packets.
+    auto n_packets = std::uint64_t{};
+    auto reader = std::thread{[fd = fds[0], &n_packets] {
+        using u16_storage = buffer<integer_size<std::uint16_t>>;
+
+        auto storage = std::vector<char>(
+            2 * (u16_storage::static_size() + command_size_max));
+
+        for(auto head = size_t{}, tail = size_t{}; true;) {
+            auto n = read(fd, storage.data() + tail, storage.size() - tail);
+            if(n <= 0) {
+                break;
+            }
+
+            tail += static_cast<size_t>(n);
+
+            // Skip all complete packets.
+            while((tail - head) >= u16_storage::static_size()) {
+                auto size_storage = u16_storage{};
+                std::memcpy(size_storage.data(), storage.data() + head,
+                            size_storage.size());
+
+                auto size = buffer_to_int<std::uint16_t>(size_storage);
+                if((tail - head - size_storage.size()) < size) {
+                    break;
+                }
+
+                head += size_storage.size() + size;
+                n_packets++;
+            }
+
+            // Move the partial packet to the beginning of the storage.
+            std::memmove(storage.data(), storage.data() + head, tail - head);
+            tail -= head;
+            head = 0;
+        }
+
+        close(fd);
+    }};
+
+    // Measure sending.
+    auto t = double{};
+    if(auto pipe = pipe_endpoint{fds[1]}; true) {
+        t = bench::measure([&] {
+            for(auto i = 0; i != n_commands; ++i) {
+                execute(pipe, string);
+            }
+        });
+    }
+
+    // Note: The write end of the pipe is closed at this point, which stops the
+    // reader.
+    reader.join();
+
+    std::printf("  sending: %.1f ns per command, %llu packets received\n",
+                (t * 1000.0) / n_commands,
+                static_cast<unsigned long long>(n_packets));
+
+    return (n_packets == n_commands) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,209 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+// Utilities which are shared by the benchmarks.
+//
+#ifndef H_4F2272F0BAD74ADEA76A3658BADD826B
+#define H_4F2272F0BAD74ADEA76A3658BADD826B
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace bench {
+
+////////////////////////////////////////////////////////////////////////////////
+// Temporary directory. Is removed with all its contents upon destruction.
+////////////////////////////////////////////////////////////////////////////////
+
+struct temporary_directory {
+    ////////////////////////////////////////////////////////////////////////////
+    // Construction/destruction.
+    ////////////////////////////////////////////////////////////////////////////
+
+    temporary_directory() {
+        char path_template[] = "/tmp/rose-bench-XXXXXX";
+        if(mkdtemp(path_template) != nullptr) {
+            this->path = path_template;
+        }
+    }
+
+    ~temporary_directory() {
+        if(auto error = std::error_code{}; !(this->path.empty())) {
+            std::filesystem::remove_all(this->path, error);
+        }
+    }
+
+    temporary_directory(temporary_directory const&) = delete;
+    temporary_directory(temporary_directory&&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Assignment operators.
+    ////////////////////////////////////////////////////////////////////////////
+
+    auto
+    operator=(temporary_directory const&) = delete;
+
+    auto
+    operator=(temporary_directory&&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Data members.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Path to the directory, or an empty path on error.
+    std::filesystem::path path;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Synthetic PATH. Consists of directories with empty executable files, which
+// are named like real commands.
+////////////////////////////////////////////////////////////////////////////////
+
+struct synthetic_path {
+    // Value of the PATH environment variable.
+    std::string value;
+
+    // Names of the created files.
+    std::vector<std::string> names;
+};
+
+// Creates the given number of directories with the given number of files each
+// in the given root directory.
+// Note: Modification times of the directories are set one hour into the past,
+// since the database does not trust the times of recently modified directories
+// (and rescans them instead of loading them from the cache).
+inline auto
+create_synthetic_path(std::filesystem::path const& root, int n_directories,
+                      int n_files_per_directory, std::mt19937& generator)
+    -> synthetic_path {
+    namespace fs = std::filesystem;
+
+    // Generate file names from a small alphabet of syllables, so that names
+    // share prefixes and subsequences like real command names do.
+    static constexpr char const* syllables[] = {
+        "a",  "ba", "co", "de", "fi", "gu", "ho", "in", "ka", "lo", "mi",
+        "nu", "ox", "pa", "qu", "re", "sh", "ti", "un", "vi", "wo", "x",
+        "yz", "-",  "_",  "2",  "3",  "gtk", "ctl", "conf", "d"};
+
+    auto generate_name = [&] {
+        auto name = std::string{};
+        auto n = std::uniform_int_distribution{2, 6}(generator);
+        for(auto i = 0; i != n; ++i) {
+            name += syllables[std::uniform_int_distribution<std::size_t>{
+                0, std::size(syllables) - 1}(generator)];
+        }
+
+        return name;
+    };
+
+    // Create the directories.
+    auto result = synthetic_path{};
+    for(auto i = 0; i != n_directories; ++i) {
+        auto directory = root / ("bin" + std::to_string(i));
+        fs::create_directories(directory);
+
+        if(!(result.value.empty())) {
+            result.value += ':';
+        }
+
+        result.value += directory.string();
+
+        for(auto j = 0; j != n_files_per_directory; ++j) {
+            auto name = generate_name() + std::to_string(j % 7);
+            auto file = directory / name;
+
+            if(auto x = std::fopen(file.c_str(), "wb"); x != nullptr) {
+                std::fclose(x);
+                fs::permissions(file, fs::perms::owner_all);
+                result.names.push_back(std::move(name));
+            }
+        }
+
+        if(auto t = timespec{}; clock_gettime(CLOCK_REALTIME, &t) == 0) {
+            t.tv_sec -= 60 * 60;
+
+            timespec times[] = {t, t};
+            utimensat(AT_FDCWD, directory.c_str(), times, 0);
+        }
+    }
+
+    return result;
+}
+
+// Points the database of executable files to the given PATH, and to an empty
+// cache and launch history in the given root directory.
+inline void
+set_environment(std::filesystem::path const& root, synthetic_path const& x) {
+    setenv("PATH", x.value.c_str(), 1);
+    setenv("XDG_CACHE_HOME", (root / "cache").c_str(), 1);
+    setenv("XDG_STATE_HOME", (root / "state").c_str(), 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Latency statistics.
+////////////////////////////////////////////////////////////////////////////////
+
+struct latency_statistics {
+    // Mean, median, 99th percentile, and maximum (in microseconds).
+    double mean, p50, p99, max;
+};
+
+// Computes statistics of the given latencies (in microseconds). Sorts the
+// given range.
+inline auto
+compute_statistics(std::vector<double>& latencies) -> latency_statistics {
+    if(latencies.empty()) {
+        return {};
+    }
+
+    std::ranges::sort(latencies);
+
+    auto mean = double{};
+    for(auto x : latencies) {
+        mean += x / static_cast<double>(latencies.size());
+    }
+
+    return {.mean = mean,
+            .p50 = latencies[latencies.size() / 2],
+            .p99 = latencies[(latencies.size() * 99) / 100],
+            .max = latencies.back()};
+}
+
+inline void
+print_statistics(char const* name, latency_statistics const& x) {
+    std::printf(
+        "  %s: mean %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us\n", name,
+        x.mean, x.p50, x.p99, x.max);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Time measurement.
+////////////////////////////////////////////////////////////////////////////////
+
+// Returns the time (in microseconds) which it takes to invoke the given
+// function.
+template <typename F>
+auto
+measure(F f) -> double {
+    auto t0 = std::chrono::steady_clock::now();
+    f();
+    auto t1 = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double, std::micro>(t1 - t0).count();
+}
+
+} // namespace bench
+
+#endif // H_4F2272F0BAD74ADEA76A3658BADD826B
@@ -0,0 +1,80 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+// Measures the time it takes to build the database of executable files from
+// scratch, to rebuild it, and to load it from the cache, over synthetic PATH
+// trees of different sizes.
+//
+#include "common.hh"
+#include "executables_database.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark parameters.
+////////////////////////////////////////////////////////////////////////////////
+
+static constexpr auto n_directories = 20;
+static constexpr int n_files_per_directory[] = {50, 500, 5000};
+static constexpr auto n_rebuilds = 5;
+
+////////////////////////////////////////////////////////////////////////////////
+// Program entry point.
+////////////////////////////////////////////////////////////////////////////////
+
+int
+main() {
+    auto generator = std::mt19937{42};
+
+    for(auto n : n_files_per_directory) {
+        // Create the synthetic PATH.
+        auto root = bench::temporary_directory{};
+        if(root.path.empty()) {
+            return EXIT_FAILURE;
+        }
+
+        auto path = bench::create_synthetic_path(
+            root.path, n_directories, n, generator);
+
+        bench::set_environment(root.path, path);
+
+        // Build the database from scratch (there is no cache yet).
+        auto t_build = bench::measure([] {
+            auto database = rose::executables_database{};
+        });
+
+        // Rebuild the database.
+        auto t_rebuild = std::vector<double>{};
+        if(auto database = rose::executables_database{}; true) {
+            for(auto i = 0; i != n_rebuilds; ++i) {
+                t_rebuild.push_back(
+                    bench::measure([&] { database.initialize(); }));
+            }
+        }
+
+        // Load the database from the cache.
+        auto t_load = std::vector<double>{};
+        for(auto i = 0; i != n_rebuilds; ++i) {
+            t_load.push_back(bench::measure([] {
+                auto database = rose::executables_database{};
+            }));
+        }
+
+        // Report the results.
+        std::printf("database_initialization: %zu files\n", path.names.size());
+        std::printf("  build: %.1f us\n", t_build);
+        bench::print_statistics(
+            "rebuild", bench::compute_statistics(t_rebuild));
+        bench::print_statistics(
+            "cache load", bench::compute_statistics(t_load));
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+// Measures per-keystroke latency of suggestion lookup in fuzzy matching mode
+// over a synthetic PATH with a large number of executable files.
+//
+#include "common.hh"
+#include "executables_database.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark parameters.
+////////////////////////////////////////////////////////////////////////////////
+
+static constexpr auto n_directories = 40;
+static constexpr auto n_files_per_directory = 1000;
+static constexpr auto n_queries = 200;
+
+// Maximum acceptable per-keystroke latency.
+static constexpr auto latency_max = std::chrono::microseconds{1000};
+
+////////////////////////////////////////////////////////////////////////////////
+// Program entry point.
+////////////////////////////////////////////////////////////////////////////////
+
+int
+main() {
+    // Create a temporary directory.
+    auto root = bench::temporary_directory{};
+    if(root.path.empty()) {
+        return EXIT_FAILURE;
+    }
+
+    // Create the synthetic PATH.
+    auto generator = std::mt19937{42};
+    auto path = bench::create_synthetic_path(
+        root.path, n_directories, n_files_per_directory, generator);
+
+    bench::set_environment(root.path, path);
+
+    auto database = rose::executables_database{rose::matching_mode::fuzzy};
+
+    // Simulate typing: each query is a subsequence of an existing name, typed
+    // one character at a time.
+    auto latencies = std::vector<double>{};
+    auto result = std::u8string{};
+
+    for(auto i = 0; i != n_queries; ++i) {
+        auto const& name = path.names[std::uniform_int_distribution<size_t>{
+            0, path.names.size() - 1}(generator)];
+
+        auto query = std::u8string{};
+        for(auto c : name) {
+            if(std::uniform_int_distribution{0, 2}(generator) == 0) {
+                continue;
+            }
+
+            query.push_back(static_cast<char8_t>(c));
+            latencies.push_back(bench::measure([&] {
+                result.clear();
+                database.lookup_suggestions(query, result);
+            }));
+        }
+    }
+
+    // Report the results.
+    auto statistics = bench::compute_statistics(latencies);
+
+    std::printf("fuzzy_matching: %zu files, %zu keystrokes\n",
+                path.names.size(), latencies.size());
+    bench::print_statistics("latency", statistics);
+
+    if(statistics.p99 > static_cast<double>(latency_max.count())) {
+        std::printf("  FAILED: p99 latency exceeds %lld us\n",
+                    static_cast<long long>(latency_max.count()));
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,84 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+// Measures per-keystroke latency of autocompletion and suggestion lookup in
+// prefix matching mode over a synthetic PATH with a large number of executable
+// files.
+//
+#include "common.hh"
+#include "executables_database.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark parameters.
+////////////////////////////////////////////////////////////////////////////////
+
+static constexpr auto n_directories = 40;
+static constexpr auto n_files_per_directory = 1000;
+static constexpr auto n_queries = 200;
+
+////////////////////////////////////////////////////////////////////////////////
+// Program entry point.
+////////////////////////////////////////////////////////////////////////////////
+
+int
+main() {
+    // Create a temporary directory.
+    auto root = bench::temporary_directory{};
+    if(root.path.empty()) {
+        return EXIT_FAILURE;
+    }
+
+    // Create the synthetic PATH.
+    auto generator = std::mt19937{42};
+    auto path = bench::create_synthetic_path(
+        root.path, n_directories, n_files_per_directory, generator);
+
+    bench::set_environment(root.path, path);
+
+    auto database = rose::executables_database{rose::matching_mode::prefix};
+
+    // Simulate typing: each query is a prefix of an existing name, typed one
+    // character at a time, followed by an argument.
+    auto latencies_autocomplete = std::vector<double>{};
+    auto latencies_lookup = std::vector<double>{};
+    auto result = std::u8string{};
+
+    for(auto i = 0; i != n_queries; ++i) {
+        auto const& name = path.names[std::uniform_int_distribution<size_t>{
+            0, path.names.size() - 1}(generator)];
+
+        auto query = std::u8string{};
+        for(auto c : name + " --help") {
+            query.push_back(static_cast<char8_t>(c));
+
+            latencies_lookup.push_back(bench::measure([&] {
+                result.clear();
+                database.lookup_suggestions(query, result);
+            }));
+
+            latencies_autocomplete.push_back(bench::measure([&] {
+                result.clear();
+                database.autocomplete(query, result);
+            }));
+        }
+    }
+
+    // Report the results.
+    std::printf("prefix_matching: %zu files, %zu keystrokes\n",
+                path.names.size(), latencies_lookup.size());
+
+    bench::print_statistics(
+        "lookup", bench::compute_statistics(latencies_lookup));
+    bench::print_statistics(
+        "autocomplete", bench::compute_statistics(latencies_autocomplete));
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,144 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+// Measures latency of text rendering into an offscreen render target at
+// different scales. The font is read from the file specified by the
+// ROSE_BENCH_FONT environment variable; the benchmark is skipped if the
+// variable is not set.
+//
+#include "common.hh"
+#include "filesystem.hh"
+#include "rendering_text.hh"
+#include "unicode.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark parameters.
+////////////////////////////////////////////////////////////////////////////////
+
+static constexpr auto font_size = 16;
+static constexpr auto target_w = 1000, target_h = 32;
+static constexpr auto n_iterations = 200;
+
+////////////////////////////////////////////////////////////////////////////////
+// Program entry point.
+////////////////////////////////////////////////////////////////////////////////
+
+int
+main() {
+    // Read the font.
+    auto font_path = std::getenv("ROSE_BENCH_FONT");
+    if(font_path == nullptr) {
+        std::printf("text_rendering: skipped (ROSE_BENCH_FONT is not set)\n");
+        return EXIT_SUCCESS;
+    }
+
+    auto fonts = std::vector<std::vector<unsigned char>>{};
+    if(fonts.emplace_back(rose::filesystem::read(font_path));
+       fonts.back().empty()) {
+        return EXIT_FAILURE;
+    }
+
+    // Define the text: the prompt, the input, and the suggestions.
+    auto text = std::u8string{
+        u8"$ fire | firefox | firefox-esr | firewall-config | firejail"};
+
+    auto n_input = text.find(u8" |");
+
+    std::printf("text_rendering:\n");
+
+    // Measure initialization of the context with font data, and with a mapped
+    // font file.
+    if(true) {
+        auto t_data = bench::measure([&] {
+            auto data = std::vector<std::vector<unsigned char>>{};
+            data.push_back(rose::filesystem::read(font_path));
+
+            auto context = rose::initialize(
+                rose::text_rendering_context_parameters{.fonts = data});
+        });
+
+        auto t_mapped = bench::measure([&] {
+            auto files = std::vector<rose::filesystem::file_mapping>{};
+            files.emplace_back(font_path);
+
+            auto context = rose::initialize(
+                rose::text_rendering_context_parameters{.font_files = files});
+        });
+
+        std::printf("  initialization: %.1f us (data), %.1f us (mapped)\n",
+                    t_data, t_mapped);
+    }
+
+    for(auto scale = 1; scale <= 3; ++scale) {
+        // Initialize a new context, so that the glyph cache is cold.
+        // Note: Font data are moved into the context, hence the copy.
+        auto context_fonts = fonts;
+        auto context = rose::initialize(
+            rose::text_rendering_context_parameters{.fonts = context_fonts});
+
+        if(!context) {
+            return EXIT_FAILURE;
+        }
+
+        // Initialize the render target.
+        auto w = target_w * scale, h = target_h * scale;
+        auto pixels = std::vector<unsigned char>(
+            static_cast<size_t>(w) * static_cast<size_t>(h) * 4);
+
+        auto target = rose::render_target{
+            .pixels = pixels.data(), .w = w, .h = h, .pitch = w * 4};
+
+        // Define a function which renders the given string.
+        auto buffer = rose::utf32_string_buffer{};
+        auto render = [&](std::u8string_view string) {
+            rose::convert_utf8_to_utf32(string, buffer);
+            return bench::measure([&] {
+                rose::render(
+                    context,
+                    {.font_size = font_size,
+                     .dpi = 96 * scale,
+                     .text_line = buffer},
+                    target);
+            });
+        };
+
+        // Render the text for the first time.
+        auto t_cold = render(text);
+
+        // Render the same text.
+        auto t_same = std::vector<double>{};
+        for(auto i = 0; i != n_iterations; ++i) {
+            t_same.push_back(render(text));
+        }
+
+        // Simulate typing: insert one character into the input, then remove
+        // it, so that each frame differs from the previous one.
+        auto t_typing = std::vector<double>{};
+        for(auto i = 0; i != n_iterations; ++i) {
+            auto string = text;
+            if((i % 2) == 0) {
+                string.insert(n_input, 1, static_cast<char8_t>(u8'a' + i % 26));
+            }
+
+            t_typing.push_back(render(string));
+        }
+
+        // Report the results.
+        std::printf("  scale %d (%dx%d, %d dpi):\n", scale, w, h, 96 * scale);
+        std::printf("    first frame: %.1f us\n", t_cold);
+
+        bench::print_statistics(
+            "  same text", bench::compute_statistics(t_same));
+        bench::print_statistics(
+            "  typing", bench::compute_statistics(t_typing));
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+// Measures throughput of UTF-8 to UTF-32 conversion of ASCII and of mixed
+// text.
+//
+#include "common.hh"
+#include "unicode.hh"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+// Benchmark parameters.
+////////////////////////////////////////////////////////////////////////////////
+
+// Note: The size of a string is similar to the size of the rendered text.
+static constexpr auto n_repetitions = 8;
+static constexpr auto n_iterations = 20000;
+
+////////////////////////////////////////////////////////////////////////////////
+// Program entry point.
+////////////////////////////////////////////////////////////////////////////////
+
+int
+main() {
+    // Define the samples.
+    struct {
+        char const* name;
+        std::u8string_view text;
+    } const samples[] = {
+        {"ascii", u8"$ firefox --new-window | fish | foot | fuzzel | "},
+        {"mixed", u8"$ grep été | шрифт | "
+                  u8"עברית | 漢字 | "}};
+
+    std::printf("unicode_conversion:\n");
+
+    for(auto const& sample : samples) {
+        // Build the string.
+        auto string = std::u8string{};
+        for(auto i = 0; i != n_repetitions; ++i) {
+            string.append(sample.text);
+        }
+
+        // Convert the string repeatedly.
+        auto buffer = rose::utf32_string_buffer{};
+        auto t = bench::measure([&] {
+            for(auto i = 0; i != n_iterations; ++i) {
+                rose::convert_utf8_to_utf32(string, buffer);
+            }
+        });
+
+        // Report the results.
+        auto n_bytes = static_cast<double>(string.size()) * n_iterations;
+        std::printf("  %s: %zu bytes, %.1f ns per string, %.1f MB/s\n",
+                    sample.name, string.size(),
+                    (t * 1000.0) / n_iterations, n_bytes / t);
+
+        if(buffer.data.empty()) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
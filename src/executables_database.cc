@@ -5,10 +5,22 @@
 //
 #include "executables_database.hh"
 
-#include <concepts>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
-#include <type_traits>
+#include <limits>
+#include <memory_resource>
+#include <thread>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace rose {
 
@@ -67,268 +79,1767 @@ split_command_string(std::u8string_view input, std::u8string& command)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Database of executable files. Construction/destruction implementation.
+// File system utility functions.
 ////////////////////////////////////////////////////////////////////////////////
 
-executables_database::executables_database() {
-    this->initialize();
+// Note: Symbolic links are followed, and only regular files are considered to
+// be executable.
+static auto
+is_executable(int directory_fd, char const* path) -> bool {
+    // Define permissions mask of executable files.
+    static constexpr auto exec_mask = (S_IXUSR | S_IXGRP | S_IXOTH);
+
+    if(struct statx x = {};
+       statx(directory_fd, path, 0, STATX_TYPE | STATX_MODE, &x) == 0) {
+        return S_ISREG(x.stx_mode) && ((x.stx_mode & exec_mask) != 0);
+    }
+
+    return false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Database of executable files. Initialization interface implementation.
+// Index construction utility functions.
 ////////////////////////////////////////////////////////////////////////////////
 
-void
-executables_database::initialize() {
-    using std::filesystem::perms;
+// Maximum size of the string arena.
+static constexpr auto arena_size_max =
+    size_t{std::numeric_limits<std::uint32_t>::max()};
 
-    // Define permissions mask of executable files.
-    static constexpr auto exec_mask =
-        (perms::owner_exec | perms::group_exec | perms::others_exec);
+static auto
+add_string(std::u8string& arena, auto... parts)
+    -> executables_index::string_entry {
+    auto offset = arena.size();
+    if((offset + ... + parts.size()) > arena_size_max) {
+        return {};
+    }
+
+    (arena.append(parts), ...);
+    return {.offset = static_cast<std::uint32_t>(offset),
+            .size = static_cast<std::uint32_t>(arena.size() - offset)};
+}
 
-    // Clear existing database.
-    this->files_.clear();
-    this->paths_.clear();
+static auto
+obtain_delimiter(std::u8string_view directory) -> std::u8string_view {
+    // Obtain a delimiter which separates directory's path from file names.
+    return (directory.ends_with(u8'/') ? u8"" : u8"/");
+}
 
-    // Do nothing else if the PATH environment variable is not set.
-    if(std::getenv("PATH") == nullptr) {
-        return;
+////////////////////////////////////////////////////////////////////////////////
+// Fuzzy matching utility functions.
+////////////////////////////////////////////////////////////////////////////////
+
+// Note: Case folding is performed with a table, since it is done for each
+// character of each candidate.
+static constexpr auto fold_case_table = [] {
+    auto result = std::array<char8_t, 256>{};
+    for(auto i = 0; i != 256; ++i) {
+        result[i] = static_cast<char8_t>(
+            ((i >= 'A') && (i <= 'Z')) ? (i - 'A' + 'a') : i);
     }
 
-    // Iterate through each path.
-    auto paths = std::string_view{std::getenv("PATH")};
-    while(!(paths.empty())) {
-        // Obtain the next directory path.
-        auto i = paths.find(':');
-        auto directory_path = paths.substr(0, i);
+    return result;
+}();
 
-        // Update the remaining paths.
-        if(i != paths.npos) {
-            paths.remove_prefix(i + 1);
+static constexpr auto
+fold_case(char8_t c) noexcept -> char8_t {
+    return fold_case_table[c];
+}
+
+// Computes a mask of characters which occur in the given string: a bit for
+// each ASCII letter (case-insensitive) and digit, and a hashed bit for any
+// other byte. If a string is a subsequence of another string, then each bit of
+// its mask is also set in the mask of the other string.
+static auto
+obtain_character_mask(std::u8string_view string) noexcept -> std::uint64_t {
+    auto result = std::uint64_t{};
+    for(auto c : string) {
+        if(c = fold_case(c); (c >= u8'a') && (c <= u8'z')) {
+            result |= std::uint64_t{1} << (c - u8'a');
+        } else if((c >= u8'0') && (c <= u8'9')) {
+            result |= std::uint64_t{1} << (26 + (c - u8'0'));
         } else {
-            paths.remove_prefix(paths.size());
+            result |= std::uint64_t{1} << (36 + (c % 28));
         }
+    }
 
-        try {
-            auto directory = std::filesystem::directory_iterator{
-                std::filesystem::path{directory_path}};
-
-            // Iterate through all files in the directory.
-            for(auto const& entry : directory) {
-                // Obtain permissions of the current file.
-                auto file_permissions = entry.status().permissions();
-
-                // Check permissions.
-                if((file_permissions & exec_mask) != perms::none) {
-                    // If the file is executable, then obtain its path.
-                    auto const& path = entry.path();
-
-                    // Add its full path to the database.
-                    this->paths_.insert(path.u8string());
-
-                    // Add its name to the database.
-                    if(!(this->files_.contains(path.filename().u8string()))) {
-                        this->files_[path.filename().u8string()] =
-                            path.parent_path().u8string();
-                    }
-                }
-            }
-        } catch(...) {
+    return result;
+}
+
+// Define fuzzy matching scoring parameters.
+static constexpr auto score_match = 16, score_gap_start = -3,
+                      score_gap_extension = -1, bonus_consecutive = 8,
+                      bonus_boundary = 8, bonus_first = 16;
+
+static constexpr auto
+is_word_separator(char8_t c) noexcept -> bool {
+    return (c == u8'-') || (c == u8'_') || (c == u8'.') || (c == u8' ');
+}
+
+// Computes the maximum possible score of a match of the given pattern: the
+// score of a match at the start of a string without gaps. Each character
+// which follows a word separator in the pattern then also starts a word.
+// Note: Starting a word after a gap can not outweigh a consecutive match.
+static auto
+compute_fuzzy_score_max(std::u8string_view pattern) noexcept -> int {
+    auto result = bonus_first + bonus_boundary + score_match;
+    for(auto i = size_t{1}; i < pattern.size(); ++i) {
+        result += score_match + bonus_consecutive +
+                  (is_word_separator(pattern[i - 1]) ? bonus_boundary : 0);
+    }
+
+    return result;
+}
+
+// Computes the score of a match of the given pattern as a subsequence of the
+// given string (ASCII case-insensitive). Returns -1 if there is no match.
+// Note: The pattern must be case-folded.
+static auto
+compute_fuzzy_score(std::u8string_view string, std::u8string_view pattern)
+    -> int {
+    // Find the shortest match which ends first: find the end of the leftmost
+    // match, then move its start as far right as possible.
+    auto last = size_t{}, j = size_t{};
+    for(; (last != string.size()) && (j != pattern.size()); ++last) {
+        if(fold_case(string[last]) == pattern[j]) {
+            ++j;
+        }
+    }
+
+    if(j != pattern.size()) {
+        return -1;
+    }
+
+    auto first = last;
+    for(j = pattern.size(); j != 0; --first) {
+        if(fold_case(string[first - 1]) == pattern[j - 1]) {
+            --j;
+        }
+    }
+
+    // Define a function which checks if the given position starts a word.
+    auto is_boundary = [&](size_t i) {
+        if(i == 0) {
+            return true;
+        }
+
+        return is_word_separator(string[i - 1]);
+    };
+
+    // Compute the score of the match.
+    auto score = ((first == 0) ? bonus_first : 0), n_gap = 0;
+    for(auto i = first, k = size_t{}; k != pattern.size(); ++i) {
+        if(fold_case(string[i]) != pattern[k]) {
+            score += ((n_gap++ == 0) ? score_gap_start : score_gap_extension);
+            continue;
+        }
+
+        score += score_match;
+        if(is_boundary(i)) {
+            score += bonus_boundary;
+        }
+
+        if((k != 0) && (n_gap == 0)) {
+            score += bonus_consecutive;
         }
+
+        n_gap = 0, ++k;
     }
+
+    return std::max(score, 0);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Database of executable files. Lookup interface implementation.
+// Index cache file format.
 ////////////////////////////////////////////////////////////////////////////////
 
-void
-executables_database::autocomplete( //
-    std::u8string_view input, std::u8string& result) {
-    // If the input is empty, then there is nothing to complete.
-    if(result.clear(); input.empty()) {
-        return;
+// Header of the cache file. The header is followed by the arrays of directory
+// modification times, character masks of file names, directories, full file
+// paths, file names, and by the string arena (in that order).
+struct executables_index_cache_header {
+    char magic[8];
+    std::uint32_t version, byte_order;
+    std::uint32_t n_directories, n_paths, n_files, strings_size;
+};
+
+static constexpr char executables_index_cache_magic[8] = {
+    'R', 'O', 'S', 'E', 'E', 'X', 'E', 'C'};
+
+static constexpr auto executables_index_cache_version = std::uint32_t{2};
+static constexpr auto executables_index_cache_byte_order =
+    std::uint32_t{0x01020304};
+
+static_assert(sizeof(executables_index_cache_header) == 32);
+static_assert(sizeof(executables_index::string_entry) == 8);
+static_assert(sizeof(executables_index::entry) == 12);
+
+////////////////////////////////////////////////////////////////////////////////
+// Index of executable files. Construction/destruction implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+executables_index::executables_index(
+    std::span<executables_directory const> directories) {
+    // Obtain a reference to index's storage.
+    auto& storage = this->storage_;
+
+    // Reserve memory.
+    if(auto n_files = size_t{}, arena_size = size_t{}; true) {
+        for(auto const& directory : directories) {
+            arena_size += directory.path.size();
+            for(auto const& name : directory.file_names) {
+                arena_size += directory.path.size() + name.size() + 1;
+            }
+
+            n_files += directory.file_names.size();
+        }
+
+        storage.strings.reserve(std::min(arena_size, arena_size_max));
+        storage.directories.reserve(directories.size());
+        storage.mtimes.reserve(directories.size());
+        storage.paths.reserve(n_files);
+        storage.files.reserve(n_files);
     }
 
-    // Define a function which preforms lookup.
-    auto perform_lookup = [&](auto const& map) {
-        // Define a function which obtains string from iterator.
-        auto string = [](auto i) -> std::u8string const& {
-            if constexpr( //
-                std::same_as<std::remove_cvref_t<decltype(*i)>,
-                             std::u8string>) {
-                return (*i);
-            } else {
-                return (*i).first;
+    // Add all files to the index.
+    for(auto const& directory : directories) {
+        // Obtain directory's ID.
+        auto const directory_id =
+            static_cast<std::uint32_t>(storage.directories.size());
+
+        // Add the directory.
+        storage.directories.push_back(
+            add_string(storage.strings, std::u8string_view{directory.path}));
+
+        storage.mtimes.push_back(directory.mtime);
+
+        // Add the files.
+        for(auto const& name : directory.file_names) {
+            auto path = add_string(
+                storage.strings, std::u8string_view{directory.path},
+                obtain_delimiter(directory.path), std::u8string_view{name});
+
+            if(path.size == 0) {
+                continue;
             }
+
+            storage.paths.push_back({.offset = path.offset,
+                                     .size = path.size,
+                                     .directory_id = directory_id});
+
+            storage.files.push_back(
+                {.offset = static_cast<std::uint32_t>(
+                     path.offset + path.size - name.size()),
+                 .size = static_cast<std::uint32_t>(name.size()),
+                 .directory_id = directory_id});
+        }
+    }
+
+    // Define a projection which obtains entry's string.
+    auto projection = [this](entry x) { return this->string(x); };
+
+    // Sort full file paths.
+    this->update_views_();
+    std::ranges::sort(storage.paths, {}, projection);
+
+    // Sort file names. Only the first occurrence of each file name is kept,
+    // since directories are given in the order of their priority.
+    if(std::ranges::stable_sort(storage.files, {}, projection); true) {
+        auto r = std::ranges::unique(storage.files, {}, projection);
+        storage.files.erase(r.begin(), r.end());
+    }
+
+    // Free unused memory.
+    storage.files.shrink_to_fit();
+
+    // Lay out the arena in the order of file names, so that scanning all file
+    // names (as fuzzy matching does) accesses the arena sequentially.
+    this->update_views_();
+    if(auto strings = std::u8string{}; true) {
+        strings.reserve(storage.strings.size());
+
+        // Define a function which copies the given string to the new arena,
+        // and returns its new offset.
+        auto relocate = [&](std::u8string_view x) {
+            auto offset = static_cast<std::uint32_t>(strings.size());
+            return strings.append(x), offset;
         };
 
-        // Obtain the command string from the input.
-        split_command_string(input, this->buffer_);
+        // Relocate the full paths of the files, in the order of file names.
+        // Note: Relocated paths are identified by their old offsets.
+        auto offsets = std::vector<std::pair<std::uint32_t, std::uint32_t>>{};
+        offsets.reserve(storage.files.size());
 
-        // Set initial sequence.
-        result = this->buffer_;
+        for(auto& x : storage.files) {
+            auto directory = this->directory(x);
+            auto prefix_size = static_cast<std::uint32_t>(
+                directory.size() + obtain_delimiter(directory).size());
 
-        // Append characters to the sequence.
-        for(auto i = map.lower_bound(result); i != map.end();
-            i = map.lower_bound(result)) {
-            // If the current suggestion does not start with the current
-            // sequence, then the sequence is complete.
-            if(!(string(i).starts_with(result))) {
-                break;
-            }
+            auto offset = relocate(
+                this->strings_.substr(x.offset - prefix_size,
+                                      prefix_size + x.size));
 
-            // If the current suggestion equals the current sequence, then
-            // the sequence is complete.
-            if(string(i) == result) {
-                break;
-            }
+            offsets.emplace_back(x.offset - prefix_size, offset);
+            x.offset = offset + prefix_size;
+        }
 
-            // Obtain the next character from the current suggestion.
-            auto const next_character = string(i)[result.size()];
-
-            // Modify the sequence so that it contains the character which
-            // is strictly greater than the next character from current
-            // suggestion.
-            result.push_back(next_character + 1);
-
-            // Find a suggestion which is strictly greater than current
-            // suggestion, and is guaranteed to differ in the next
-            // character.
-            auto j = map.lower_bound(result);
-
-            // Update the sequence.
-            result.pop_back();
-            if((j == map.end()) || !(string(j).starts_with(result))) {
-                result.push_back(next_character);
-            } else if(string(i)[result.size()] == string(j)[result.size()]) {
-                result.push_back(next_character);
+        std::ranges::sort(offsets);
+
+        // Relocate the remaining paths.
+        for(auto& x : storage.paths) {
+            if(auto i = std::ranges::lower_bound(
+                   offsets, x.offset, {}, [](auto y) { return y.first; });
+               (i != offsets.end()) && (i->first == x.offset)) {
+                x.offset = i->second;
             } else {
-                break;
+                x.offset = relocate(this->string(x));
             }
         }
 
-        // Remove prefix from resulting sequence.
-        result.erase(0, this->buffer_.size());
+        // Relocate the directories.
+        for(auto& x : storage.directories) {
+            x.offset = relocate(this->string(x));
+        }
+
+        storage.strings = std::move(strings);
+    }
+
+    // Compute character masks of file names.
+    this->update_views_();
+    this->update_masks_();
+}
 
-        // Clear temporary buffer.
-        this->buffer_.clear();
+// Merges the given sorted list of added entries into the given sorted list of
+// base entries, and skips the base entries with the given sorted indices. Runs
+// of base entries are copied with the first given function, and each added
+// entry is inserted with the second one.
+// Note: Only insertion points of the added entries are found with string
+// comparisons (using binary search), so their number is proportional to the
+// number of changes.
+template <typename Projection, typename Copy, typename Insert>
+static void
+merge_entries(std::span<executables_index::entry const> base,
+              std::span<executables_index::entry const> added,
+              std::span<size_t const> removed, Projection projection,
+              Copy copy, Insert insert) {
+    // Define a function which copies base entries up to the given index,
+    // skipping the removed ones.
+    auto first = size_t{};
+    auto i = removed.begin();
+    auto copy_until = [&](size_t last) {
+        while(first < last) {
+            if((i != removed.end()) && (*i == first)) {
+                ++i, ++first;
+                continue;
+            }
 
-        // Add escape characters.
-        result = append_escaped(result, this->buffer_);
+            auto end = (((i != removed.end()) && (*i < last)) ? *i : last);
+            copy(first, end);
+            first = end;
+        }
     };
 
-    // Lookup suggestions based on input.
-    if(input.starts_with(u8'/')) {
-        perform_lookup(this->paths_);
-    } else {
-        perform_lookup(this->files_);
-    }
-}
+    // Merge the entries.
+    for(auto x : added) {
+        auto j = std::ranges::upper_bound(
+            base, projection(x), {}, projection);
 
-void
-executables_database::lookup_suggestions( //
-    std::u8string_view input, std::u8string& result) {
-    // If the input is empty, then there are no suggestions.
-    if(input.empty()) {
-        return;
+        copy_until(static_cast<size_t>(j - base.begin()));
+        insert(x);
     }
 
-    // Split the command string.
-    auto arguments = split_command_string(input, this->buffer_);
+    copy_until(base.size());
+}
 
-    // Add the command string.
-    this->append_command_string_(this->buffer_, arguments, result);
+executables_index::executables_index(
+    executables_index const& base,
+    std::span<executables_change const> changes) {
+    // Obtain a reference to index's storage.
+    auto& storage = this->storage_;
 
-    // If arguments string is not empty, then do nothing else.
-    if(!(arguments.empty())) {
-        return;
-    }
+    // Copy the arena and the directories.
+    storage.strings = base.strings_;
+    storage.directories.assign(
+        base.directories_.begin(), base.directories_.end());
 
-    // Add delimiter.
-    result.append(u8" *");
+    storage.mtimes.assign(base.mtimes_.begin(), base.mtimes_.end());
 
-    // Define the maximum number of suggestions.
-    static constexpr auto n_suggestions_max = 5;
+    // Define a projection which obtains entry's string.
+    auto projection = [this](entry x) { return this->string(x); };
 
-    // Lookup suggestions based on input.
-    if(auto i = 0; input.starts_with(u8'/')) {
-        for(auto suggestion = this->paths_.lower_bound(this->buffer_);
-            suggestion != this->paths_.end(); ++suggestion) {
-            if(!(suggestion->starts_with(this->buffer_))) {
-                break;
-            }
+    // Find the paths which must be added to or removed from the index.
+    auto added = std::vector<entry>{}, removed = std::vector<entry>{};
+    auto removed_paths = std::vector<size_t>{};
+    for(auto path = std::u8string{}; auto const& change : changes) {
+        // Skip invalid changes.
+        if(change.directory_id >= storage.directories.size()) {
+            continue;
+        }
 
-            if(*suggestion != this->buffer_) {
-                auto suffix = std::u8string_view{*suggestion}.substr(
-                    this->buffer_.size());
+        // Note: The arena might have been reallocated.
+        this->update_views_();
 
-                append_escaped(suffix, result.append(u8" \xE2\x80\xA6"));
-            } else {
-                continue;
-            }
+        // Construct file's full path.
+        auto directory = this->string(storage.directories[change.directory_id]);
+        path.assign(directory)
+            .append(obtain_delimiter(directory))
+            .append(change.file_name);
 
-            if(++i == n_suggestions_max) {
-                break;
+        // Check if the path is present in the index.
+        auto is_present = false;
+        if(auto range = base.find_paths(path); !(range.empty())) {
+            if(is_present = (base.string(range.front()) == path); is_present) {
+                if(!(change.is_executable)) {
+                    removed.push_back(range.front());
+                    removed_paths.push_back(static_cast<size_t>(
+                        range.data() - base.paths_.data()));
+                }
             }
         }
-    } else {
-        for(auto suggestion = this->files_.lower_bound(this->buffer_);
-            suggestion != this->files_.end(); ++suggestion) {
-            if(!(suggestion->first.starts_with(this->buffer_))) {
-                break;
+
+        // Add the path to the arena, if needed.
+        if(change.is_executable && !is_present) {
+            if(auto x = add_string(storage.strings, std::u8string_view{path});
+               x.size != 0) {
+                added.push_back({.offset = x.offset,
+                                 .size = x.size,
+                                 .directory_id = change.directory_id});
             }
+        }
+    }
+
+    // Sort the added paths, and remove duplicates.
+    if(this->update_views_(); true) {
+        std::ranges::sort(added, {}, projection);
+        auto r = std::ranges::unique(added, {}, projection);
+        added.erase(r.begin(), r.end());
+    }
 
-            append_escaped_path(suggestion->second, result.append(u8" "));
-            if(suggestion->first != this->buffer_) {
-                auto suffix = std::u8string_view{suggestion->first}.substr(
-                    this->buffer_.size());
+    // Merge the paths.
+    std::ranges::sort(removed_paths);
+    storage.paths.reserve(base.paths_.size() + added.size());
+    merge_entries(
+        base.paths_, added, removed_paths, projection,
+        [&](size_t first, size_t last) {
+            storage.paths.insert(storage.paths.end(),
+                                 base.paths_.begin() + first,
+                                 base.paths_.begin() + last);
+        },
+        [&](entry x) { storage.paths.push_back(x); });
 
-                append_escaped(suffix, result.append(u8"\xE2\x80\xA6"));
-            } else {
-                append_escaped(this->buffer_, result);
-            }
+    // Obtain the names of the files which have been changed.
+    auto names = std::vector<std::u8string_view>{};
+    for(auto const& x : {std::span{added}, std::span{removed}}) {
+        for(auto y : x) {
+            auto directory = this->directory(y);
+            names.push_back(projection(y).substr(
+                directory.size() + obtain_delimiter(directory).size()));
+        }
+    }
 
-            if(++i == n_suggestions_max) {
-                break;
+    if(std::ranges::sort(names); true) {
+        auto r = std::ranges::unique(names);
+        names.erase(r.begin(), r.end());
+    }
+
+    // For each changed name, find the directory with the highest priority which
+    // contains a file with such name.
+    auto files = std::vector<entry>{};
+    for(auto path = std::u8string{}; auto name : names) {
+        for(this->update_views_(); auto x : storage.directories) {
+            auto directory = this->string(x);
+            path.assign(directory)
+                .append(obtain_delimiter(directory))
+                .append(name);
+
+            if(auto range = this->find_paths(path); !(range.empty())) {
+                if(auto y = range.front(); projection(y) == path) {
+                    files.push_back(
+                        {.offset = y.offset + y.size -
+                                   static_cast<std::uint32_t>(name.size()),
+                         .size = static_cast<std::uint32_t>(name.size()),
+                         .directory_id = y.directory_id});
+                    break;
+                }
             }
         }
     }
+
+    // Find the file names which must be replaced.
+    auto removed_files = std::vector<size_t>{};
+    for(auto name : names) {
+        if(auto x = base.find_file(name); x != nullptr) {
+            removed_files.push_back(
+                static_cast<size_t>(x - base.files_.data()));
+        }
+    }
+
+    // Merge the file names and their character masks.
+    // Note: Character masks are only computed for the added file names.
+    storage.files.reserve(base.files_.size() + files.size());
+    storage.masks.reserve(base.files_.size() + files.size());
+    merge_entries(
+        base.files_, files, removed_files, projection,
+        [&](size_t first, size_t last) {
+            storage.files.insert(storage.files.end(),
+                                 base.files_.begin() + first,
+                                 base.files_.begin() + last);
+            storage.masks.insert(storage.masks.end(),
+                                 base.masks_.begin() + first,
+                                 base.masks_.begin() + last);
+        },
+        [&](entry x) {
+            storage.files.push_back(x);
+            storage.masks.push_back(obtain_character_mask(projection(x)));
+        });
+
+    this->update_views_();
+    this->masks_ = storage.masks;
 }
 
-void
-executables_database::modify_command_string( //
-    std::u8string_view input, std::u8string& result) {
-    // Clear the resulting string.
-    result.clear();
+////////////////////////////////////////////////////////////////////////////////
+// Index of executable files. Cache interface implementation.
+////////////////////////////////////////////////////////////////////////////////
 
-    // Split the command string.
-    auto arguments = split_command_string(input, this->buffer_);
+auto
+executables_index::load(std::filesystem::path const& path)
+    -> std::shared_ptr<executables_index const> {
+    // Map the file.
+    auto mapping = filesystem::file_mapping{path};
+    auto data = mapping.data();
 
-    // Construct modified command string.
-    this->append_command_string_(this->buffer_, arguments, result);
+    // Read the header.
+    auto header = executables_index_cache_header{};
+    if(data.size() < sizeof(header)) {
+        return nullptr;
+    }
+
+    std::memcpy(&header, data.data(), sizeof(header));
+
+    // Validate the header.
+    if(!std::ranges::equal(header.magic, executables_index_cache_magic) ||
+       (header.version != executables_index_cache_version) ||
+       (header.byte_order != executables_index_cache_byte_order)) {
+        return nullptr;
+    }
+
+    // Compute the size of the file.
+    auto const size = //
+        sizeof(header) +
+        size_t{header.n_directories} *
+            (sizeof(std::int64_t) + sizeof(string_entry)) +
+        size_t{header.n_paths} * sizeof(entry) +
+        size_t{header.n_files} * (sizeof(entry) + sizeof(std::uint64_t)) +
+        size_t{header.strings_size};
+
+    if(data.size() != size) {
+        return nullptr;
+    }
+
+    // Construct an index which refers to the data of the file.
+    auto result = std::make_shared<executables_index>();
+    if(auto offset = sizeof(header); true) {
+        // Define a function which obtains an array of the given type.
+        auto view = [&]<typename T>(std::type_identity<T>, size_t n) {
+            auto p = reinterpret_cast<T const*>(data.data() + offset);
+            return (offset += n * sizeof(T)), std::span{p, n};
+        };
+
+        result->mtimes_ =
+            view(std::type_identity<std::int64_t>{}, header.n_directories);
+
+        result->masks_ =
+            view(std::type_identity<std::uint64_t>{}, header.n_files);
+
+        result->directories_ =
+            view(std::type_identity<string_entry>{}, header.n_directories);
+
+        result->paths_ = view(std::type_identity<entry>{}, header.n_paths);
+        result->files_ = view(std::type_identity<entry>{}, header.n_files);
+
+        result->strings_ = std::u8string_view{
+            reinterpret_cast<char8_t const*>(data.data() + offset),
+            header.strings_size};
+    }
+
+    // Validate the entries.
+    auto is_valid_string = [&](auto x) {
+        return (size_t{x.offset} + size_t{x.size}) <= result->strings_.size();
+    };
+
+    auto is_valid_entry = [&](entry x) {
+        return is_valid_string(x) && (x.directory_id < header.n_directories);
+    };
+
+    if(!std::ranges::all_of(result->directories_, is_valid_string) ||
+       !std::ranges::all_of(result->paths_, is_valid_entry) ||
+       !std::ranges::all_of(result->files_, is_valid_entry)) {
+        return nullptr;
+    }
+
+    // Note: Views of the index refer to the mapped memory, which does not
+    // change its address when the mapping is moved.
+    result->mapping_ = std::move(mapping);
+    return result;
+}
+
+auto
+executables_index::save(std::filesystem::path const& path) const -> bool {
+    // Initialize the header.
+    auto header = executables_index_cache_header{
+        .version = executables_index_cache_version,
+        .byte_order = executables_index_cache_byte_order,
+        .n_directories = static_cast<std::uint32_t>(this->directories_.size()),
+        .n_paths = static_cast<std::uint32_t>(this->paths_.size()),
+        .n_files = static_cast<std::uint32_t>(this->files_.size()),
+        .strings_size = static_cast<std::uint32_t>(this->strings_.size())};
+
+    std::ranges::copy(executables_index_cache_magic, header.magic);
+
+    // Define a function which obtains the bytes of the given range.
+    auto bytes = [](auto const& x) {
+        return std::span{reinterpret_cast<unsigned char const*>(std::data(x)),
+                         std::size(x) * sizeof(*std::data(x))};
+    };
+
+    // Write the file.
+    return filesystem::write(
+        path, {bytes(std::span{&header, 1}), bytes(this->mtimes_),
+               bytes(this->masks_), bytes(this->directories_),
+               bytes(this->paths_), bytes(this->files_),
+               bytes(this->strings_)});
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Database of executable files. Utility functions implementation.
+// Index of executable files. Accessors implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+executables_index::memory_usage() const noexcept -> size_t {
+    return this->strings_.size() +
+           this->directories_.size() *
+               (sizeof(string_entry) + sizeof(std::int64_t)) +
+           this->paths_.size() * sizeof(entry) +
+           this->files_.size() * (sizeof(entry) + sizeof(std::uint64_t));
+}
+
+auto
+executables_index::is_fragmented() const noexcept -> bool {
+    // Compute the size of used space of the arena.
+    auto n = size_t{};
+    for(auto x : this->paths_) {
+        n += x.size;
+    }
+
+    for(auto x : this->directories_) {
+        n += x.size;
+    }
+
+    // The index is fragmented if more than a half of the arena is unused.
+    return (this->strings_.size() > (2 * n));
+}
+
+auto
+executables_index::extract() const -> std::vector<executables_directory> {
+    // Initialize the list of directories.
+    auto result = std::vector<executables_directory>{};
+    result.reserve(this->directories_.size());
+
+    for(auto i = size_t{}; i != this->directories_.size(); ++i) {
+        auto& directory = result.emplace_back();
+        directory.path = this->string(this->directories_[i]);
+        directory.mtime = this->mtimes_[i];
+    }
+
+    // Add file names to their directories.
+    for(auto x : this->paths_) {
+        auto& directory = result[x.directory_id];
+        directory.file_names.emplace_back(this->string(x).substr(
+            directory.path.size() + obtain_delimiter(directory.path).size()));
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Index of executable files. Utility functions implementation.
 ////////////////////////////////////////////////////////////////////////////////
 
 void
-executables_database::append_command_string_( //
-    std::u8string_view command, std::u8string_view arguments,
-    std::u8string& result) {
-    if(command.starts_with(u8'/')) {
-        append_escaped(command, result);
-    } else {
-        if(auto i = this->files_.find(command); i != this->files_.end()) {
-            append_escaped(i->first, append_escaped_path(i->second, result));
-        } else {
-            append_escaped(command, result);
-        }
+executables_index::update_views_() noexcept {
+    this->strings_ = this->storage_.strings;
+    this->directories_ = this->storage_.directories;
+    this->mtimes_ = this->storage_.mtimes;
+    this->paths_ = this->storage_.paths;
+    this->files_ = this->storage_.files;
+}
+
+void
+executables_index::update_masks_() {
+    this->storage_.masks.clear();
+    this->storage_.masks.reserve(this->files_.size());
+
+    for(auto x : this->files_) {
+        this->storage_.masks.push_back(
+            obtain_character_mask(this->string(x)));
     }
 
-    if(!(arguments.empty())) {
-        result.append(u8" ").append(arguments);
+    this->masks_ = this->storage_.masks;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Index of executable files. Lookup interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+executables_index::find_prefix_range(std::span<entry const> entries,
+                                     std::u8string_view prefix) const
+    -> std::span<entry const> {
+    // Define a projection which obtains entry's string.
+    auto projection = [this](auto x) { return this->string(x); };
+
+    // Find the first entry which is not less than the prefix.
+    auto first = std::ranges::lower_bound(entries, prefix, {}, projection);
+
+    // All entries which start with the prefix are adjacent.
+    auto last = std::ranges::partition_point(
+        first, entries.end(),
+        [&](auto x) { return projection(x).starts_with(prefix); });
+
+    return {first, last};
+}
+
+auto
+executables_index::find_paths(std::u8string_view prefix) const
+    -> std::span<entry const> {
+    return this->find_prefix_range(this->paths_, prefix);
+}
+
+auto
+executables_index::find_files(std::u8string_view prefix) const
+    -> std::span<entry const> {
+    return this->find_prefix_range(this->files_, prefix);
+}
+
+auto
+executables_index::find_file(std::u8string_view name) const
+    -> entry const* {
+    if(auto range = this->find_files(name); !(range.empty())) {
+        if(this->string(range.front()) == name) {
+            return &(range.front());
+        }
+    }
+
+    return nullptr;
+}
+
+auto
+executables_index::find_files_fuzzy(
+    std::u8string_view pattern, std::span<entry const*> result,
+    std::vector<std::uint32_t>* candidates) const -> size_t {
+    // Define a type of the match, and a function which compares matches.
+    // Note: Among the matches with equal scores, shorter file name has higher
+    // rank, and among the names of equal length, lexicographically smaller
+    // one.
+    struct match {
+        int score;
+        entry const* x;
+    };
+
+    auto compare = [](match const& a, match const& b) {
+        return (a.score > b.score) ||
+               ((a.score == b.score) &&
+                ((a.x->size < b.x->size) ||
+                 ((a.x->size == b.x->size) && (a.x < b.x))));
+    };
+
+    if(pattern.empty()) {
+        return 0;
+    }
+
+    // Initialize an arena for temporary data.
+    // Note: The arena uses the storage on the stack, which is large enough for
+    // typical patterns and lists of results, so that the lookup does not
+    // allocate memory on the heap.
+    std::byte arena_storage[1024];
+    auto arena = std::pmr::monotonic_buffer_resource{
+        arena_storage, sizeof(arena_storage)};
+
+    // Select the matches with the highest scores with a bounded min-heap.
+    auto heap = std::pmr::vector<match>{&arena};
+    heap.reserve(result.size() + 1);
+
+    auto const pattern_mask = obtain_character_mask(pattern);
+    auto const score_max = compute_fuzzy_score_max(pattern);
+
+    // Fold the case of the pattern.
+    auto pattern_folded = std::pmr::u8string{pattern, &arena};
+    std::ranges::transform(pattern_folded, pattern_folded.begin(), fold_case);
+
+    // Define a function which processes the file name with the given index.
+    // Returns false if the file name does not match the pattern.
+    auto process = [&](size_t i) {
+        auto x = &(this->files_[i]);
+        auto string = this->string(*x);
+
+        // If the list of matches is full, then skip the file name if it can
+        // not outrank the worst selected match. Only the file names which
+        // start with the first character of the pattern can obtain the bonus
+        // for it.
+        // Note: Skipped file names are kept as candidates.
+        if(heap.size() == result.size()) {
+            auto score = score_max;
+            if(string.empty() ||
+               (fold_case(string.front()) != pattern_folded.front())) {
+                score -= bonus_first;
+            }
+
+            if(result.empty() || (score < heap.front().score) ||
+               ((score == heap.front().score) &&
+                (x->size >= heap.front().x->size))) {
+                return true;
+            }
+        }
+
+        // Compute the score, and skip the file name if it does not match.
+        auto m = match{compute_fuzzy_score(string, pattern_folded), x};
+        if(m.score < 0) {
+            return false;
+        }
+
+        // Skip the match if it does not outrank the worst selected match.
+        if((heap.size() == result.size()) && !compare(m, heap.front())) {
+            return true;
+        }
+
+        heap.push_back(m);
+        std::ranges::push_heap(heap, compare);
+
+        if(heap.size() > result.size()) {
+            std::ranges::pop_heap(heap, compare);
+            heap.pop_back();
+        }
+
+        return true;
+    };
+
+    if((candidates != nullptr) && !(candidates->empty())) {
+        // Consider only the given candidates, and keep the matching ones.
+        std::erase_if(*candidates, [&](auto i) {
+            return (i >= this->files_.size()) || !process(i);
+        });
+    } else {
+        // Note: The character mask of the pattern rejects most of the entries
+        // without looking at their strings, and the masks are stored in a
+        // contiguous array, which is scanned sequentially.
+        for(auto i = size_t{}, n = this->masks_.size(); i != n; ++i) {
+            if((this->masks_[i] & pattern_mask) != pattern_mask) {
+                continue;
+            }
+
+            if(process(i) && (candidates != nullptr)) {
+                candidates->push_back(static_cast<std::uint32_t>(i));
+            }
+        }
+    }
+
+    // Write the matches in the order of their rank.
+    std::ranges::sort_heap(heap, compare);
+    std::ranges::transform(heap, result.begin(), &match::x);
+
+    return heap.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Directory scanning utility functions.
+////////////////////////////////////////////////////////////////////////////////
+
+static auto
+obtain_mtime(int fd, char const* path, int flags) -> std::int64_t {
+    if(struct statx x = {};
+       statx(fd, path, flags, STATX_MTIME, &x) == 0) {
+        return std::int64_t{x.stx_mtime.tv_sec} * 1'000'000'000 +
+               x.stx_mtime.tv_nsec;
+    }
+
+    return 0;
+}
+
+static auto
+obtain_directory_mtime(std::u8string const& path) -> std::int64_t {
+    return obtain_mtime(
+        AT_FDCWD, reinterpret_cast<char const*>(path.c_str()), 0);
+}
+
+static auto
+obtain_path_directories() -> std::vector<std::u8string> {
+    // Obtain the list of paths.
+    auto result = std::vector<std::u8string>{};
+    if(std::getenv("PATH") == nullptr) {
+        return result;
+    }
+
+    // Iterate through each path.
+    auto paths = std::string_view{std::getenv("PATH")};
+    while(!(paths.empty())) {
+        // Obtain the next directory path.
+        auto i = paths.find(':');
+        auto directory_path = paths.substr(0, i);
+
+        // Update the remaining paths.
+        if(i != paths.npos) {
+            paths.remove_prefix(i + 1);
+        } else {
+            paths.remove_prefix(paths.size());
+        }
+
+        // Remove trailing directory separators.
+        while((directory_path.size() > 1) && directory_path.ends_with('/')) {
+            directory_path.remove_suffix(1);
+        }
+
+        // Skip empty and repeated directories.
+        if(directory_path.empty() ||
+           std::ranges::any_of(result, [&](auto const& x) {
+               return std::ranges::equal(x, directory_path);
+           })) {
+            continue;
+        }
+
+        // Add the directory.
+        result.emplace_back(directory_path.begin(), directory_path.end());
+    }
+
+    return result;
+}
+
+template <typename F>
+static void
+run_in_parallel(size_t n_tasks, F f) {
+    // Define the maximum number of threads.
+    static constexpr auto n_threads_max = size_t{8};
+
+    // Obtain the number of threads.
+    auto n_threads = std::min(
+        {n_tasks, n_threads_max,
+         std::max(size_t{std::thread::hardware_concurrency()}, size_t{1})});
+
+    // Run the tasks.
+    // Note: The calling thread also runs the tasks, so if additional threads
+    // can not be started, then all tasks are run sequentially.
+    auto i_next = std::atomic<size_t>{};
+    auto run = [&] {
+        for(auto i = i_next++; i < n_tasks; i = i_next++) {
+            f(i);
+        }
+    };
+
+    auto threads = std::vector<std::jthread>{};
+    for(auto i = size_t{1}; i < n_threads; ++i) {
+        try {
+            threads.emplace_back(run);
+        } catch(...) {
+            break;
+        }
+    }
+
+    run();
+}
+
+static auto
+scan_directories(std::span<std::u8string const> paths)
+    -> std::vector<executables_directory> {
+    using namespace std::literals::chrono_literals;
+
+    // Define the number of files which are checked in a single task.
+    static constexpr auto batch_size = size_t{64};
+
+    // Define the state of a directory scan.
+    struct scan {
+        // Descriptor of the directory, and its modification time.
+        int fd = -1;
+        std::int64_t mtime;
+
+        // Names of the files which might be executable, and the results of
+        // their checks.
+        std::vector<std::u8string> file_names;
+        std::vector<unsigned char> checks;
+    };
+
+    auto scans = std::vector<scan>(paths.size());
+
+    // Obtain the time of the scan.
+    // Note: Modification times which are too close to the time of the scan are
+    // not reliable, since subsequent modifications might not change them.
+    auto const t_reliable =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            (std::chrono::system_clock::now() - 2s).time_since_epoch())
+            .count();
+
+    // Read the entries of all directories.
+    run_in_parallel(paths.size(), [&](size_t i) {
+        // Open the directory.
+        auto& scan = scans[i];
+        scan.fd = open(reinterpret_cast<char const*>(paths[i].c_str()),
+                       O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        if(scan.fd == -1) {
+            return;
+        }
+
+        // Obtain directory's modification time before reading its contents,
+        // so that any concurrent modification makes the result outdated.
+        if(scan.mtime = obtain_mtime(scan.fd, "", AT_EMPTY_PATH);
+           scan.mtime >= t_reliable) {
+            scan.mtime = 0;
+        }
+
+        // Read the entries in bulk.
+        alignas(struct dirent64) char buffer[32768];
+        for(auto n = getdents64(scan.fd, buffer, sizeof(buffer)); n > 0;
+            n = getdents64(scan.fd, buffer, sizeof(buffer))) {
+            for(auto offset = decltype(n){}; offset < n;) {
+                auto entry =
+                    reinterpret_cast<struct dirent64*>(buffer + offset);
+                offset += entry->d_reclen;
+
+                // Skip special entries.
+                if((std::strcmp(entry->d_name, ".") == 0) ||
+                   (std::strcmp(entry->d_name, "..") == 0)) {
+                    continue;
+                }
+
+                // Skip entries which are known not to be regular files.
+                // Note: Symbolic links must be checked, since they might
+                // point to regular files.
+                if((entry->d_type != DT_REG) && (entry->d_type != DT_LNK) &&
+                   (entry->d_type != DT_UNKNOWN)) {
+                    continue;
+                }
+
+                scan.file_names.emplace_back(
+                    reinterpret_cast<char8_t const*>(entry->d_name));
+            }
+        }
+
+        scan.checks.resize(scan.file_names.size());
+    });
+
+    // Split executable-bit checks of all files into batches.
+    auto batches = std::vector<std::pair<size_t, size_t>>{};
+    for(auto i = size_t{}; i != scans.size(); ++i) {
+        for(auto j = size_t{}; j < scans[i].file_names.size();
+            j += batch_size) {
+            batches.emplace_back(i, j);
+        }
+    }
+
+    // Check the files.
+    run_in_parallel(batches.size(), [&](size_t i) {
+        auto& scan = scans[batches[i].first];
+        for(auto j = batches[i].second,
+                 n = std::min(j + batch_size, scan.file_names.size());
+            j != n; ++j) {
+            scan.checks[j] = is_executable(
+                scan.fd,
+                reinterpret_cast<char const*>(scan.file_names[j].c_str()));
+        }
+    });
+
+    // Construct the directories.
+    auto result = std::vector<executables_directory>{};
+    result.reserve(paths.size());
+
+    for(auto i = size_t{}; i != paths.size(); ++i) {
+        auto& scan = scans[i];
+        auto& directory = result.emplace_back(
+            executables_directory{.path = paths[i], .mtime = scan.mtime});
+
+        if(scan.fd == -1) {
+            continue;
+        }
+
+        // Obtain the names of executable files.
+        for(auto j = size_t{}; j != scan.file_names.size(); ++j) {
+            if(scan.checks[j] != 0) {
+                directory.file_names.push_back(
+                    std::move(scan.file_names[j]));
+            }
+        }
+
+        // Close the directory.
+        close(scan.fd);
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Database of executable files. Construction/destruction implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+executables_database::executables_database(matching_mode mode)
+    : matching_mode_{mode}
+    , cache_path_{filesystem::obtain_xdg_path(
+          "XDG_CACHE_HOME", ".cache", "dispatcher-executables")}
+    , history_{filesystem::obtain_xdg_path(
+          "XDG_STATE_HOME", ".local/state", "dispatcher-history")} {
+    // Load the initial index from the cache, or build it.
+    if(!(this->load_cache_())) {
+        this->initialize();
+    }
+
+    // Start the thread which rebuilds the index on request.
+    this->reload_thread_ = std::jthread{
+        [this](std::stop_token stop) { this->run_reload_loop_(stop); }};
+}
+
+executables_database::~executables_database() {
+    // Stop the thread which rebuilds the index.
+    // Note: The thread must be stopped before the inotify file descriptor is
+    // closed, since the thread adds watches to it.
+    if(this->reload_thread_.joinable()) {
+        this->reload_thread_.request_stop();
+        this->reload_thread_.join();
+    }
+
+    if(this->watch_fd_ != -1) {
+        close(this->watch_fd_);
+        this->watch_fd_ = -1;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Database of executable files. Initialization interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+void
+executables_database::initialize() {
+    // Scan all directories.
+    auto directories = scan_directories(obtain_path_directories());
+
+    // Build the index and publish it.
+    auto index = std::make_shared<executables_index const>(directories);
+    this->index_.store(index);
+
+    // Update the cache.
+    this->save_cache_(*index);
+}
+
+void
+executables_database::reload() {
+    if(auto lock = std::scoped_lock{this->reload_mutex_}; true) {
+        this->is_reload_requested_ = true;
+    }
+
+    this->reload_condition_.notify_one();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Database of executable files. Watch mode interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+executables_database::watch() -> int {
+    // Do nothing if watching has already started.
+    if(this->watch_fd_ != -1) {
+        return this->watch_fd_;
+    }
+
+    // Initialize inotify instance.
+    if(this->watch_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+       this->watch_fd_ == -1) {
+        return -1;
+    }
+
+    // Add watches for all directories.
+    this->update_watches_();
+
+    // Return inotify file descriptor.
+    return this->watch_fd_;
+}
+
+auto
+executables_database::process_watch_events() -> bool {
+    // Initialize storage for events.
+    alignas(struct inotify_event) char buffer[4096];
+
+    // Read all pending events.
+    auto events = decltype(this->pending_events_){};
+    for(auto is_reload_needed = false;;) {
+        auto n = read(this->watch_fd_, buffer, sizeof(buffer));
+        if(n == -1) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            // Schedule the events for processing, if there are no more events
+            // to read.
+            if((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+                if(auto lock = std::scoped_lock{this->reload_mutex_}; true) {
+                    this->is_reload_requested_ |= is_reload_needed;
+                    this->pending_events_.insert(
+                        this->pending_events_.end(),
+                        std::make_move_iterator(events.begin()),
+                        std::make_move_iterator(events.end()));
+                }
+
+                this->reload_condition_.notify_one();
+                return true;
+            }
+
+            return false;
+        }
+
+        if(n == 0) {
+            return false;
+        }
+
+        // Process the events.
+        for(auto offset = ssize_t{}; offset < n;) {
+            auto event =
+                reinterpret_cast<struct inotify_event*>(buffer + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            // If the event queue has overflown, or a directory has been
+            // removed, then the index must be rebuilt.
+            if((event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF |
+                               IN_MOVE_SELF | IN_IGNORED)) != 0) {
+                is_reload_needed = true;
+                continue;
+            }
+
+            // Save the event.
+            if(event->len != 0) {
+                events.emplace_back(
+                    event->wd, reinterpret_cast<char8_t*>(event->name));
+            }
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Database of executable files. Lookup interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+void
+executables_database::autocomplete( //
+    std::u8string_view input, std::u8string& result) {
+    // If the input is empty, then there is nothing to complete.
+    if(result.clear(); input.empty()) {
+        return;
+    }
+
+    // Obtain current index.
+    auto const index = this->index_.load();
+
+    // Obtain the command string from the input.
+    split_command_string(input, this->buffer_);
+
+    // Find all suggestions which start with the command string.
+    auto suggestions =
+        this->find_matches_(*index, this->buffer_, input.starts_with(u8'/'));
+
+    if(suggestions.empty()) {
+        return;
+    }
+
+    // Since suggestions are sorted, their common prefix is the common prefix
+    // of the first and the last suggestion.
+    auto first = index->string(suggestions.front());
+    auto last = index->string(suggestions.back());
+
+    auto n = std::ranges::mismatch(first, last).in1 - first.begin();
+
+    // Add the completed sequence with escape characters.
+    append_escaped(first.substr(0, n).substr(this->buffer_.size()), result);
+}
+
+void
+executables_database::lookup_suggestions( //
+    std::u8string_view input, std::u8string& result) {
+    // If the input is empty, then there are no suggestions.
+    if(input.empty()) {
+        return;
+    }
+
+    // Obtain current index.
+    auto const index = this->index_.load();
+
+    // Split the command string.
+    auto arguments = split_command_string(input, this->buffer_);
+
+    // Add the command string.
+    this->append_command_string_(*index, this->buffer_, arguments, result);
+
+    // If arguments string is not empty, then do nothing else.
+    if(!(arguments.empty())) {
+        return;
+    }
+
+    // Add delimiter.
+    result.append(u8" *");
+
+    // Obtain the entries which match the input.
+    auto const is_path = input.starts_with(u8'/');
+    auto const matches = this->find_matches_(*index, this->buffer_, is_path);
+
+    // Select the suggestions.
+    auto suggestions = this->select_suggestions_(*index, matches, is_path);
+
+    // Add the suggestions.
+    for(auto suggestion : suggestions) {
+        if(suggestion == nullptr) {
+            break;
+        }
+
+        if(is_path) {
+            append_escaped(
+                index->string(*suggestion).substr(this->buffer_.size()),
+                result.append(u8" \xE2\x80\xA6"));
+        } else {
+            append_escaped_path(
+                index->directory(*suggestion), result.append(u8" "));
+
+            // Note: In fuzzy matching mode suggestions might not start with
+            // the input.
+            if(auto string = index->string(*suggestion);
+               (string != this->buffer_) &&
+               string.starts_with(this->buffer_)) {
+                append_escaped(string.substr(this->buffer_.size()),
+                               result.append(u8"\xE2\x80\xA6"));
+            } else {
+                append_escaped(string, result);
+            }
+        }
+    }
+}
+
+void
+executables_database::modify_command_string( //
+    std::u8string_view input, std::u8string& result) {
+    // Clear the resulting string.
+    result.clear();
+
+    // Split the command string.
+    auto arguments = split_command_string(input, this->buffer_);
+
+    // Construct modified command string.
+    this->append_command_string_(
+        *(this->index_.load()), this->buffer_, arguments, result);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Database of executable files. Launch history interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+void
+executables_database::record_launch(std::u8string_view command_string) {
+    // Record the command only if it has been resolved to a full path.
+    if(split_command_string(command_string, this->buffer_);
+       this->buffer_.starts_with(u8'/')) {
+        this->history_.record(this->buffer_);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Database of executable files. Utility functions implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+void
+executables_database::append_command_string_( //
+    executables_index const& index, std::u8string_view command,
+    std::u8string_view arguments, std::u8string& result) {
+    if(command.starts_with(u8'/')) {
+        append_escaped(command, result);
+    } else {
+        // Note: The file with the given name is the first entry of the range
+        // of file names which start with it.
+        auto file = static_cast<executables_index::entry const*>(nullptr);
+        if(auto range = this->find_matches_(index, command, false);
+           !(range.empty()) && (index.string(range.front()) == command)) {
+            file = &(range.front());
+        }
+
+        if(file != nullptr) {
+            append_escaped(index.string(*file),
+                           append_escaped_path(index.directory(*file), result));
+        } else {
+            // Note: In fuzzy matching mode, the command is not replaced with
+            // the best match if there is no file with the given name, so that
+            // only the typed command is launched.
+            append_escaped(command, result);
+        }
+    }
+
+    if(!(arguments.empty())) {
+        result.append(u8" ").append(arguments);
+    }
+}
+
+auto
+executables_database::select_suggestions_(
+    executables_index const& index,
+    std::span<executables_index::entry const> matches, bool is_path)
+    -> suggestion_list {
+    using entry = executables_index::entry;
+
+    // In fuzzy matching mode, file names are ranked by their matching scores.
+    if(!is_path && (this->matching_mode_ == matching_mode::fuzzy)) {
+        return this->find_files_fuzzy_(index, this->buffer_);
+    }
+
+    // Define a function which checks if the given entry can be suggested.
+    // Note: A full path is not suggested if it is equal to the input.
+    auto is_suggested = [&](entry const* x) {
+        return (x >= matches.data()) &&
+               (x < (matches.data() + matches.size())) &&
+               !(is_path && (index.string(*x) == this->buffer_));
+    };
+
+    // Define a function which finds an entry for the given command.
+    auto find_entry = [&](std::u8string_view command) -> entry const* {
+        if(is_path) {
+            if(!(command.starts_with(this->buffer_))) {
+                return nullptr;
+            }
+
+            if(auto r = index.find_paths(command);
+               !(r.empty()) && (index.string(r.front()) == command)) {
+                return &(r.front());
+            }
+        } else {
+            // Note: The command must be the file with the highest priority.
+            auto i = command.rfind(u8'/');
+            if(!(command.substr(i + 1).starts_with(this->buffer_))) {
+                return nullptr;
+            }
+
+            if(auto x = index.find_file(command.substr(i + 1)); x != nullptr) {
+                auto directory = index.directory(*x);
+                if(auto prefix = command.substr(0, i + 1);
+                   prefix.starts_with(directory) &&
+                   (prefix.substr(directory.size()) ==
+                    obtain_delimiter(directory))) {
+                    return x;
+                }
+            }
+        }
+
+        return nullptr;
+    };
+
+    // Select the entries with the highest scores in the launch history. The
+    // selection is performed with a bounded min-heap.
+    auto heap = std::array<std::pair<double, entry const*>,
+                           n_suggestions_max + 1>{};
+    auto heap_size = size_t{};
+
+    // Note: Among the entries with equal scores, lexicographically smaller
+    // entry has higher rank.
+    auto compare = [](auto const& x, auto const& y) {
+        return (x.first > y.first) ||
+               ((x.first == y.first) && (x.second < y.second));
+    };
+
+    for(auto const& [command, score] : this->history_.scores()) {
+        if(auto x = find_entry(command); (x != nullptr) && is_suggested(x)) {
+            heap[heap_size++] = {score, x};
+            std::push_heap(heap.begin(), heap.begin() + heap_size, compare);
+
+            if(heap_size > n_suggestions_max) {
+                std::pop_heap(heap.begin(), heap.begin() + heap_size, compare);
+                heap_size--;
+            }
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.begin() + heap_size, compare);
+
+    // Initialize the list of suggestions.
+    auto result = suggestion_list{};
+    auto n = size_t{};
+
+    for(; n != heap_size; ++n) {
+        result[n] = heap[n].second;
+    }
+
+    // Fill the rest of the list with the remaining entries in lexicographic
+    // order.
+    for(auto const& x : matches) {
+        if(n == n_suggestions_max) {
+            break;
+        }
+
+        if(is_suggested(&x) &&
+           (std::ranges::find(result.begin(), result.begin() + n, &x) ==
+            (result.begin() + n))) {
+            result[n++] = &x;
+        }
+    }
+
+    return result;
+}
+
+auto
+executables_database::find_matches_(executables_index const& index,
+                                    std::u8string_view prefix, bool is_path)
+    -> std::span<executables_index::entry const> {
+    // Note: The index of the last lookup is kept alive, so its address
+    // identifies it.
+    auto& x = this->range_stack_;
+
+    // Reset the stack if the index or the kind of entries have changed.
+    if((x.index.get() != &index) || (x.is_path != is_path) ||
+       (x.ranges.empty())) {
+        x.index = index.shared_from_this();
+        x.is_path = is_path;
+        x.prefix.clear();
+        x.ranges.assign(
+            1, (is_path ? index.find_paths({}) : index.find_files({})));
+    }
+
+    // Pop the ranges of the prefixes which are not prefixes of the given one.
+    if(auto n = static_cast<size_t>(
+           std::ranges::mismatch(x.prefix, prefix).in1 - x.prefix.begin());
+       true) {
+        x.prefix.resize(n);
+        x.ranges.resize(n + 1);
+    }
+
+    // Narrow the last range for each of the remaining characters.
+    while(x.prefix.size() != prefix.size()) {
+        x.prefix.push_back(prefix[x.prefix.size()]);
+        x.ranges.push_back(index.find_prefix_range(x.ranges.back(), x.prefix));
+    }
+
+    return x.ranges.back();
+}
+
+auto
+executables_database::find_files_fuzzy_(
+    executables_index const& index, std::u8string_view pattern)
+    -> suggestion_list const& {
+    // Note: The index of the last lookup is kept alive, so its address
+    // identifies it.
+    auto& x = this->fuzzy_lookup_;
+    auto const is_same_index = (x.index.get() == &index);
+
+    // The same lookup is performed for the command string and for the
+    // suggestions, so the result of the last lookup is reused.
+    if(is_same_index && (x.pattern == pattern)) {
+        return x.result;
+    }
+
+    // If the pattern extends the pattern of the last lookup, then only the
+    // file names which have matched the last pattern are considered.
+    auto const is_continued = is_same_index && !(x.pattern.empty()) &&
+                              pattern.starts_with(x.pattern);
+
+    if(!is_continued) {
+        x.index = index.shared_from_this();
+        x.candidates.clear();
+    }
+
+    x.pattern = pattern;
+    x.result = {};
+
+    // Note: If the last lookup has not found any matches, then neither will
+    // the continued one.
+    if(!is_continued || !(x.candidates.empty())) {
+        index.find_files_fuzzy(pattern, x.result, &(x.candidates));
+    }
+
+    return x.result;
+}
+
+void
+executables_database::update_watches_() {
+    // Define watched events.
+    static constexpr auto mask =
+        (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+         IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+
+    // Add a watch for each directory of the index.
+    // Note: Adding a watch for already watched directory returns its existing
+    // watch descriptor.
+    auto index = this->index_.load();
+    auto watch_descriptors = std::vector<int>{};
+
+    for(auto x : index->directories()) {
+        auto path = std::filesystem::path{index->string(x)};
+        watch_descriptors.push_back(
+            inotify_add_watch(this->watch_fd_, path.c_str(), mask));
+    }
+
+    // Save the watch descriptors.
+    if(auto lock = std::scoped_lock{this->reload_mutex_}; true) {
+        this->watch_descriptors_ = std::move(watch_descriptors);
+    }
+}
+
+void
+executables_database::apply_watch_events_(
+    std::vector<std::pair<int, std::u8string>> events) {
+    // Obtain current index.
+    auto const index = this->index_.load();
+
+    // Obtain directory IDs which correspond to the watch descriptors.
+    // Note: Aliased directories (e.g., /bin and /usr/bin on systems with merged
+    // /usr) share the same watch descriptor, so each change is applied to all
+    // of them.
+    auto changes = std::vector<executables_change>{};
+    if(auto lock = std::scoped_lock{this->reload_mutex_}; true) {
+        auto const& watch_descriptors = this->watch_descriptors_;
+        for(auto const& [watch_descriptor, file_name] : events) {
+            for(auto i = size_t{}; i != watch_descriptors.size(); ++i) {
+                if(watch_descriptors[i] == watch_descriptor) {
+                    changes.push_back(
+                        {.directory_id = static_cast<std::uint32_t>(i),
+                         .file_name = file_name});
+                }
+            }
+        }
+    }
+
+    // Remove duplicates.
+    if(auto projection = [](auto const& x) {
+           return std::tie(x.directory_id, x.file_name);
+       };
+       true) {
+        std::ranges::sort(changes, {}, projection);
+        auto r = std::ranges::unique(changes, {}, projection);
+        changes.erase(r.begin(), r.end());
+    }
+
+    // Obtain current state of the files.
+    for(auto path = std::u8string{}; auto& change : changes) {
+        if(change.directory_id < index->directories().size()) {
+            auto directory =
+                index->string(index->directories()[change.directory_id]);
+
+            path.assign(directory)
+                .append(obtain_delimiter(directory))
+                .append(change.file_name);
+
+            change.is_executable = is_executable(
+                AT_FDCWD, reinterpret_cast<char const*>(path.c_str()));
+        }
+    }
+
+    // Patch the index.
+    if(changes.empty()) {
+        return;
+    }
+
+    auto patched = std::make_shared<executables_index const>(*index, changes);
+
+    // Compact the patched index, if needed.
+    if(patched->is_fragmented()) {
+        patched = std::make_shared<executables_index const>(patched->extract());
+    }
+
+    // Publish the index.
+    this->index_.store(std::move(patched));
+}
+
+auto
+executables_database::load_cache_() -> bool {
+    // Load the cached index.
+    auto index = executables_index::load(this->cache_path_);
+    if(!index) {
+        return false;
+    }
+
+    // Make sure it has been built from the same list of directories.
+    auto paths = obtain_path_directories();
+    if(!std::ranges::equal(
+           paths, index->directories(), {}, {},
+           [&](auto x) { return index->string(x); })) {
+        return false;
+    }
+
+    // Find outdated directories.
+    auto outdated = std::vector<size_t>{};
+    for(auto i = size_t{}; i != paths.size(); ++i) {
+        if(auto mtime = index->directory_mtimes()[i];
+           (mtime == 0) || (mtime != obtain_directory_mtime(paths[i]))) {
+            outdated.push_back(i);
+        }
+    }
+
+    // If all directories are up to date, then use the cached index directly.
+    if(outdated.empty()) {
+        this->index_.store(std::move(index));
+        return true;
+    }
+
+    // Otherwise, rescan only outdated directories.
+    auto directories = index->extract();
+    if(auto outdated_paths = std::vector<std::u8string>{}; true) {
+        for(auto i : outdated) {
+            outdated_paths.push_back(paths[i]);
+        }
+
+        auto scanned = scan_directories(outdated_paths);
+        for(auto i = size_t{}; i != outdated.size(); ++i) {
+            directories[outdated[i]] = std::move(scanned[i]);
+        }
+    }
+
+    // Build the index and publish it.
+    index = std::make_shared<executables_index const>(directories);
+    this->index_.store(index);
+
+    // Update the cache.
+    this->save_cache_(*index);
+    return true;
+}
+
+void
+executables_database::save_cache_(executables_index const& index) {
+    if(!(this->cache_path_.empty())) {
+        auto error = std::error_code{};
+        std::filesystem::create_directories(
+            this->cache_path_.parent_path(), error);
+
+        index.save(this->cache_path_);
+    }
+}
+
+void
+executables_database::run_reload_loop_(std::stop_token stop) {
+    while(!(stop.stop_requested())) {
+        // Wait for the next request.
+        auto is_reload_requested = false;
+        auto events = decltype(this->pending_events_){};
+
+        if(auto lock = std::unique_lock{this->reload_mutex_}; true) {
+            if(!(this->reload_condition_.wait(lock, stop, [this] {
+                   return this->is_reload_requested_ ||
+                          !(this->pending_events_.empty());
+               }))) {
+                break;
+            }
+
+            // Requests which arrive from now on will trigger another update,
+            // since they may observe changes which the current one misses.
+            is_reload_requested =
+                std::exchange(this->is_reload_requested_, false);
+            events = std::move(this->pending_events_);
+            this->pending_events_.clear();
+        }
+
+        if(is_reload_requested) {
+            // Rebuild the index. Pending events are already accounted for.
+            this->initialize();
+
+            // Watch the directories which have been re-created.
+            if(this->watch_fd_ != -1) {
+                this->update_watches_();
+            }
+        } else {
+            // Patch the index.
+            this->apply_watch_events_(std::move(events));
+        }
     }
 }
 
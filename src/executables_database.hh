@@ -6,13 +6,269 @@
 #ifndef H_15887E9CADE3431D9A0B0B929D5D70A6
 #define H_15887E9CADE3431D9A0B0B929D5D70A6
 
-#include <map>
-#include <set>
+#include "filesystem.hh"
+#include "launch_history.hh"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
 
 namespace rose {
 
+////////////////////////////////////////////////////////////////////////////////
+// Standard integer type.
+////////////////////////////////////////////////////////////////////////////////
+
+using std::size_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Directory of executable files. Serves as an input for index construction.
+////////////////////////////////////////////////////////////////////////////////
+
+struct executables_directory {
+    // Path to the directory.
+    std::u8string path;
+
+    // Modification time of the directory (in nanoseconds) observed before its
+    // contents have been read, or zero if it is unknown.
+    std::int64_t mtime;
+
+    // Names of executable files which are located in the directory.
+    std::vector<std::u8string> file_names;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Change of the state of a file in one of the directories of the index.
+////////////////////////////////////////////////////////////////////////////////
+
+struct executables_change {
+    // ID of the directory which contains the file.
+    std::uint32_t directory_id;
+
+    // Name of the file.
+    std::u8string file_name;
+
+    // Current state of the file.
+    bool is_executable;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Index of executable files. The index is immutable: all its strings are
+// stored in a single contiguous arena, and its entries refer to these strings
+// by their offsets. The data of the index are either owned by it, or belong to
+// a memory-mapped cache file.
+////////////////////////////////////////////////////////////////////////////////
+
+struct executables_index
+    : std::enable_shared_from_this<executables_index> {
+    ////////////////////////////////////////////////////////////////////////////
+    // Entry types.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // A string which is stored in the arena.
+    struct string_entry {
+        std::uint32_t offset, size;
+    };
+
+    // A string which is stored in the arena, and an ID of the directory it
+    // refers to.
+    struct entry {
+        std::uint32_t offset, size, directory_id;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Construction/destruction.
+    ////////////////////////////////////////////////////////////////////////////
+
+    executables_index() = default;
+
+    // Note: Directories must be given in the order of their priority.
+    executables_index(std::span<executables_directory const> directories);
+
+    // Constructs a copy of the given index with the given changes applied.
+    executables_index(executables_index const& base,
+                      std::span<executables_change const> changes);
+
+    // Note: Views of index's data may refer to the index itself.
+    executables_index(executables_index const&) = delete;
+    executables_index(executables_index&&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Assignment operators.
+    ////////////////////////////////////////////////////////////////////////////
+
+    auto
+    operator=(executables_index const&) = delete;
+
+    auto
+    operator=(executables_index&&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Cache interface.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Loads the index from the given cache file. The index refers to the data
+    // of the memory-mapped file directly. Returns null pointer on error.
+    static auto
+    load(std::filesystem::path const& path)
+        -> std::shared_ptr<executables_index const>;
+
+    auto
+    save(std::filesystem::path const& path) const -> bool;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Accessors.
+    ////////////////////////////////////////////////////////////////////////////
+
+    auto
+    string(string_entry x) const noexcept -> std::u8string_view {
+        return std::u8string_view{this->strings_}.substr(x.offset, x.size);
+    }
+
+    auto
+    string(entry x) const noexcept -> std::u8string_view {
+        return std::u8string_view{this->strings_}.substr(x.offset, x.size);
+    }
+
+    auto
+    directory(entry x) const noexcept -> std::u8string_view {
+        return this->string(this->directories_[x.directory_id]);
+    }
+
+    auto
+    directories() const noexcept -> std::span<string_entry const> {
+        return this->directories_;
+    }
+
+    auto
+    directory_mtimes() const noexcept -> std::span<std::int64_t const> {
+        return this->mtimes_;
+    }
+
+    auto
+    memory_usage() const noexcept -> size_t;
+
+    // Returns true if a significant part of the arena is occupied by the
+    // strings which are not referenced by any entry.
+    auto
+    is_fragmented() const noexcept -> bool;
+
+    // Returns the list of directories this index has been built from (in the
+    // order of their priority).
+    auto
+    extract() const -> std::vector<executables_directory>;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Lookup interface.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Returns a subrange of the given sorted range of entries which start with
+    // the given prefix.
+    auto
+    find_prefix_range(std::span<entry const> entries,
+                      std::u8string_view prefix) const
+        -> std::span<entry const>;
+
+    // Returns a sorted range of full file paths which start with the given
+    // prefix.
+    auto
+    find_paths(std::u8string_view prefix) const -> std::span<entry const>;
+
+    // Returns a sorted range of file names which start with the given prefix.
+    // Each name refers to the directory with the highest priority.
+    auto
+    find_files(std::u8string_view prefix) const -> std::span<entry const>;
+
+    // Returns a pointer to the entry with the given file name, or null pointer
+    // if there is no such entry.
+    auto
+    find_file(std::u8string_view name) const -> entry const*;
+
+    // Finds file names which contain the given pattern as a subsequence (ASCII
+    // case-insensitive), and writes the best matches to the given array in the
+    // order of their rank. Returns the number of written matches.
+    //
+    // If the given list of candidates is not empty, then only the file names
+    // with the listed indices are considered. On return, the list contains the
+    // indices of all file names which might match the pattern (including all
+    // matching ones). Since a file name which contains a pattern also contains
+    // each of the pattern's prefixes, the list allows incremental search while
+    // the pattern is being typed.
+    auto
+    find_files_fuzzy(std::u8string_view pattern,
+                     std::span<entry const*> result,
+                     std::vector<std::uint32_t>* candidates = nullptr) const
+        -> size_t;
+
+private:
+    ////////////////////////////////////////////////////////////////////////////
+    // Utility functions.
+    ////////////////////////////////////////////////////////////////////////////
+
+    void
+    update_views_() noexcept;
+
+    void
+    update_masks_();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Data members.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // String arena.
+    std::u8string_view strings_;
+
+    // Directories and their modification times, directory IDs are indices in
+    // these arrays.
+    std::span<string_entry const> directories_;
+    std::span<std::int64_t const> mtimes_;
+
+    // Sorted full file paths.
+    std::span<entry const> paths_;
+
+    // Sorted file names. Each name is stored in the arena as a suffix of the
+    // corresponding full file path.
+    std::span<entry const> files_;
+
+    // Character masks of file names (in the same order as file names).
+    std::span<std::uint64_t const> masks_;
+
+    // Data owned by the index.
+    struct {
+        std::u8string strings;
+        std::vector<string_entry> directories;
+        std::vector<std::int64_t> mtimes;
+        std::vector<entry> paths, files;
+        std::vector<std::uint64_t> masks;
+    } storage_;
+
+    // Memory-mapped cache file.
+    filesystem::file_mapping mapping_;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Matching mode of the database.
+////////////////////////////////////////////////////////////////////////////////
+
+enum struct matching_mode {
+    // Commands are matched by their prefixes.
+    prefix,
+
+    // Commands which contain the input as a subsequence are matched, and are
+    // ranked by their matching scores.
+    fuzzy
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Database of executable files.
 ////////////////////////////////////////////////////////////////////////////////
@@ -22,15 +278,51 @@ struct executables_database {
     // Construction/destruction.
     ////////////////////////////////////////////////////////////////////////////
 
-    executables_database();
+    executables_database(matching_mode mode = matching_mode::prefix);
+    ~executables_database();
+
+    executables_database(executables_database const&) = delete;
+    executables_database(executables_database&&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Assignment operators.
+    ////////////////////////////////////////////////////////////////////////////
+
+    auto
+    operator=(executables_database const&) = delete;
+
+    auto
+    operator=(executables_database&&) = delete;
 
     ////////////////////////////////////////////////////////////////////////////
     // Initialization interface.
     ////////////////////////////////////////////////////////////////////////////
 
+    // Rebuilds the index in the calling thread.
     void
     initialize();
 
+    // Requests the index to be rebuilt in the background. Lookups use the
+    // current index until the new one is ready. Multiple requests which arrive
+    // before the rebuild starts are served by a single rebuild.
+    void
+    reload();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Watch mode interface.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Starts watching the directories of the index for changes. Returns a
+    // file descriptor which must be serviced with process_watch_events() each
+    // time it becomes readable, or -1 on error.
+    auto
+    watch() -> int;
+
+    // Reads pending file system events, and schedules the index to be patched
+    // in the background. Returns false if watching can not continue.
+    auto
+    process_watch_events() -> bool;
+
     ////////////////////////////////////////////////////////////////////////////
     // Lookup interface.
     ////////////////////////////////////////////////////////////////////////////
@@ -44,15 +336,64 @@ struct executables_database {
     void
     modify_command_string(std::u8string_view input, std::u8string& result);
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Launch history interface.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Records the launch of the given command string (as produced by
+    // modify_command_string). Suggestions which have been launched frequently
+    // and recently are ranked higher.
+    void
+    record_launch(std::u8string_view command_string);
+
 private:
+    ////////////////////////////////////////////////////////////////////////////
+    // Suggestion list type.
+    ////////////////////////////////////////////////////////////////////////////
+
+    static constexpr auto n_suggestions_max = size_t{5};
+
+    // Note: Unused elements of the list are null pointers.
+    using suggestion_list =
+        std::array<executables_index::entry const*, n_suggestions_max>;
+
     ////////////////////////////////////////////////////////////////////////////
     // Utility functions.
     ////////////////////////////////////////////////////////////////////////////
 
     void
     append_command_string_( //
-        std::u8string_view command, std::u8string_view arguments,
-        std::u8string& result);
+        executables_index const& index, std::u8string_view command,
+        std::u8string_view arguments, std::u8string& result);
+
+    auto
+    find_matches_(executables_index const& index, std::u8string_view prefix,
+                  bool is_path) -> std::span<executables_index::entry const>;
+
+    auto
+    find_files_fuzzy_(executables_index const& index,
+                      std::u8string_view pattern) -> suggestion_list const&;
+
+    auto
+    select_suggestions_(
+        executables_index const& index,
+        std::span<executables_index::entry const> matches, bool is_path)
+        -> suggestion_list;
+
+    void
+    update_watches_();
+
+    void
+    apply_watch_events_(std::vector<std::pair<int, std::u8string>> events);
+
+    auto
+    load_cache_() -> bool;
+
+    void
+    save_cache_(executables_index const& index);
+
+    void
+    run_reload_loop_(std::stop_token stop);
 
     ////////////////////////////////////////////////////////////////////////////
     // Data members.
@@ -61,11 +402,50 @@ private:
     // Temporary string buffer.
     std::u8string buffer_;
 
-    // Database of full file paths.
-    std::set<std::u8string, std::less<>> paths_;
+    // Matching mode, and the last fuzzy lookup.
+    matching_mode matching_mode_;
+
+    struct {
+        std::shared_ptr<executables_index const> index;
+        std::u8string pattern;
+        std::vector<std::uint32_t> candidates;
+        suggestion_list result;
+    } fuzzy_lookup_;
+
+    // Stack of the ranges of the entries which start with each prefix of the
+    // last looked up string. Since the input only grows or shrinks at its end,
+    // each lookup narrows or pops the ranges of the previous one.
+    struct {
+        std::shared_ptr<executables_index const> index;
+        bool is_path;
+        std::u8string prefix;
+        std::vector<std::span<executables_index::entry const>> ranges;
+    } range_stack_;
+
+    // Path to the cache file of the index.
+    std::filesystem::path cache_path_;
+
+    // History of launched commands.
+    launch_history history_;
+
+    // Index of executable files. The index is replaced atomically, so each
+    // lookup operates on a consistent snapshot.
+    std::atomic<std::shared_ptr<executables_index const>> index_;
+
+    // Watch mode state: inotify file descriptor and watch descriptors of the
+    // directories of the index (indexed by directory IDs).
+    std::atomic_int watch_fd_ = -1;
+    std::vector<int> watch_descriptors_;
+
+    // Pending updates: reload requests and file system events (each event is
+    // represented by its watch descriptor and file name).
+    std::mutex reload_mutex_;
+    std::condition_variable_any reload_condition_;
+    std::vector<std::pair<int, std::u8string>> pending_events_;
+    bool is_reload_requested_ = false;
 
-    // Database of file names with corresponding paths.
-    std::map<std::u8string, std::u8string, std::less<>> files_;
+    // Thread which rebuilds the index.
+    std::jthread reload_thread_;
 };
 
 } // namespace rose
@@ -6,33 +6,30 @@
 #include "buffer.hh"
 #include "execution.hh"
 
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 
-#include <sys/wait.h>
+#include <sys/uio.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <spawn.h>
 #include <unistd.h>
 
 namespace rose {
 
 ////////////////////////////////////////////////////////////////////////////////
-// Command initialization utility function.
+// Command initialization interface implementation.
 ////////////////////////////////////////////////////////////////////////////////
 
 auto
-initialize_command(std::u8string_view string) {
-    // Initialize an empty command.
-    struct {
-        buffer<64 * 1024, char8_t> storage;
-        size_t size;
-    } command = {};
-
+initialize_command(std::u8string_view string, std::u8string& command) -> bool {
     // Write the command to the storage.
+    command.clear();
     for(auto is_escaped = false; auto c : string) {
-        if(command.size == (command.storage.size() - 1)) {
-            command.size = 0;
-            return command;
+        if(command.size() == (command_size_max - 1)) {
+            return false;
         }
 
         if(!is_escaped && (c == u8'\\')) {
@@ -41,39 +38,140 @@ initialize_command(std::u8string_view string) {
         }
 
         if(c == u8' ') {
-            if(is_escaped) {
-                command.storage[command.size++] = c;
-            } else {
-                command.storage[command.size++] = '\0';
-            }
+            command.push_back(is_escaped ? c : u8'\0');
         } else {
-            command.storage[command.size++] = c;
+            command.push_back(c);
         }
 
         is_escaped = false;
     }
 
-    if(command.size != 0) {
-        if(command.storage[command.size - 1] != '\0') {
-            command.size++;
+    if(command.empty()) {
+        return false;
+    }
+
+    if(command.back() != u8'\0') {
+        command.push_back(u8'\0');
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Command launching utility functions and types.
+////////////////////////////////////////////////////////////////////////////////
+
+struct launch_attributes {
+    ////////////////////////////////////////////////////////////////////////////
+    // Construction/destruction.
+    ////////////////////////////////////////////////////////////////////////////
+
+    launch_attributes() {
+        posix_spawnattr_init(&(this->handle));
+
+        // Launched processes start new sessions.
+        // Note: Signals which are handled or ignored by the executor are reset
+        // to their default actions, and all signals are unblocked.
+        auto signals_default = sigset_t{}, signals_mask = sigset_t{};
+        sigemptyset(&signals_default);
+        sigemptyset(&signals_mask);
+
+        for(auto signal : {SIGALRM, SIGCHLD, SIGPIPE, SIGQUIT, SIGTERM, SIGHUP,
+                           SIGINT}) {
+            sigaddset(&signals_default, signal);
+        }
+
+        posix_spawnattr_setsigdefault(&(this->handle), &signals_default);
+        posix_spawnattr_setsigmask(&(this->handle), &signals_mask);
+        posix_spawnattr_setflags(
+            &(this->handle), POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGDEF |
+                                 POSIX_SPAWN_SETSIGMASK);
+    }
+
+    ~launch_attributes() {
+        posix_spawnattr_destroy(&(this->handle));
+    }
+
+    launch_attributes(launch_attributes const&) = delete;
+    launch_attributes(launch_attributes&&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Assignment operators.
+    ////////////////////////////////////////////////////////////////////////////
+
+    auto
+    operator=(launch_attributes const&) = delete;
+
+    auto
+    operator=(launch_attributes&&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Data members.
+    ////////////////////////////////////////////////////////////////////////////
+
+    posix_spawnattr_t handle;
+};
+
+static auto
+launch(launch_attributes const& attributes, char* const* arguments)
+    -> execution_report {
+    // Note: The spawning function returns only after the child process has
+    // executed the command (or has failed to do so), hence its duration is the
+    // latency of the launch.
+    auto t0 = std::chrono::steady_clock::now();
+    auto pid = pid_t{-1};
+
+    auto error = posix_spawnp(
+        &pid, arguments[0], nullptr, &(attributes.handle), arguments, environ);
+
+    auto t1 = std::chrono::steady_clock::now();
+
+    // Return the result.
+    return {.id = 0,
+            .pid = ((error == 0) ? pid : -1),
+            .error = error,
+            .spawn_time = t0.time_since_epoch(),
+            .latency = (t1 - t0)};
+}
+
+static auto
+launch(launch_attributes const& attributes, std::span<char> command)
+    -> execution_report {
+    // Initialize storage for arguments.
+    char* argument_storage[256] = {};
+
+    // Initialize arguments.
+    auto arguments =
+        std::span{argument_storage, std::size(argument_storage) - 1};
+
+    for(auto offset = size_t{}; auto& argument : arguments) {
+        offset += std::strlen(argument = command.data() + offset) + 1;
+
+        if(offset == command.size()) {
+            break;
         }
     }
 
-    // Return the command.
-    return command;
+    // Execute the command.
+    return launch(attributes, arguments.data());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Unix pipe endpoint. Construction/destruction implementation.
 ////////////////////////////////////////////////////////////////////////////////
 
-pipe_endpoint::pipe_endpoint(int fd) : fd_{fd} {
+pipe_endpoint::pipe_endpoint(int fd, int report_fd)
+    : fd_{fd}, report_fd_{report_fd}, command_{} {
 }
 
 pipe_endpoint::~pipe_endpoint() {
     if(this->fd_ != -1) {
         close(this->fd_);
     }
+
+    if(this->report_fd_ != -1) {
+        close(this->report_fd_);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -81,62 +179,104 @@ pipe_endpoint::~pipe_endpoint() {
 ////////////////////////////////////////////////////////////////////////////////
 
 auto
-execute(ipc_client& client, std::u8string_view string) -> execution_result {
-    if(auto command = initialize_command(string); command.size != 0) {
-        if(request_execution(
-               client, std::span{command.storage}.first(command.size))) {
-            return execution_result::success;
+execute(pipe_endpoint& pipe, std::u8string_view string) -> execution_result {
+    // Write the command to pipe's storage.
+    auto& command = pipe.command_;
+    if(!initialize_command(string, command)) {
+        return execution_result::failure;
+    }
+
+    // Initialize packet's header.
+    auto size = int_to_buffer(static_cast<std::uint16_t>(command.size()));
+
+    // Write the header and the command with a single system call.
+    // Note: The cycle also handles partial writes.
+    iovec packet[] = {{.iov_base = size.data(), .iov_len = size.size()},
+                      {.iov_base = command.data(), .iov_len = command.size()}};
+
+    for(auto chunks = std::span<iovec>{packet}; !(chunks.empty());) {
+        // Write the chunks.
+        auto n = writev(pipe, chunks.data(), static_cast<int>(chunks.size()));
+        if(n == -1) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            return execution_result::failure;
+        }
+
+        // Skip the chunks which have been written.
+        for(auto k = static_cast<size_t>(n); !(chunks.empty());) {
+            if(k < chunks[0].iov_len) {
+                chunks[0].iov_base = static_cast<char*>(chunks[0].iov_base) + k;
+                chunks[0].iov_len -= k;
+                break;
+            }
+
+            k -= chunks[0].iov_len;
+            chunks = chunks.subspan(1);
         }
     }
 
-    return execution_result::failure;
+    return execution_result::success;
 }
 
 auto
-execute(pipe_endpoint const& pipe, std::u8string_view string)
-    -> execution_result {
-    if(auto command = initialize_command(string); command.size != 0) {
-        // Define a function which writes to the pipe.
-        auto write_pipe = [&pipe](auto const& range) -> bool {
-            // Write data.
-            auto n = ssize_t{};
-            while((n = write(pipe, range.data(), range.size())) == -1) {
-                if(errno != EINTR) {
-                    return false;
-                }
+receive_execution_reports(pipe_endpoint const& pipe,
+                          std::function<void(execution_report const&)> f)
+    -> bool {
+    // Read all available reports.
+    // Note: Each report is written with a single system call, and is never
+    // split between reads.
+    while(true) {
+        execution_report reports[64];
+
+        auto n = read(pipe.report_fd(), reports, sizeof(reports));
+        if(n == -1) {
+            if(errno == EINTR) {
+                continue;
             }
 
-            // Write succeeded.
-            return true;
-        };
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+        }
 
-        // Write packet to the pipe.
-        auto size = int_to_buffer(static_cast<std::uint16_t>(command.size));
-        if(write_pipe(size)) {
-            if(write_pipe(std::span{command.storage}.first(command.size))) {
-                return execution_result::success;
-            }
+        // If the pipe has been closed, then the executor has terminated.
+        if(n == 0) {
+            return false;
         }
-    }
 
-    return execution_result::failure;
+        // Process the reports.
+        for(auto& report :
+            std::span{reports, static_cast<size_t>(n) / sizeof(reports[0])}) {
+            f(report);
+        }
+    }
 }
 
 auto
 run_executor_process() -> pipe_endpoint {
-    // Define an array of pipe file descriptors.
-    int pipe_fds[2] = {};
+    // Define arrays of pipe file descriptors: one pipe for commands, and one
+    // for execution reports.
+    int pipe_fds[2] = {}, report_fds[2] = {};
 
-    // Create a pipe.
+    // Create the pipes.
     if(pipe(pipe_fds) == -1) {
         return -1;
     }
 
+    if(pipe2(report_fds, O_CLOEXEC | O_NONBLOCK) == -1) {
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return -1;
+    }
+
     // Fork.
     switch(fork()) {
         case -1:
             close(pipe_fds[0]);
             close(pipe_fds[1]);
+            close(report_fds[0]);
+            close(report_fds[1]);
             return -1;
 
         case 0: {
@@ -145,119 +285,106 @@ run_executor_process() -> pipe_endpoint {
             // Ignore SIGPIPE.
             signal(SIGPIPE, SIG_IGN);
 
-            // Close the file descriptor of the write end of the pipe.
+            // Ignore SIGCHLD.
+            // Note: This way launched processes are reaped by the system as
+            // soon as they terminate, and the executor never waits for them.
+            signal(SIGCHLD, SIG_IGN);
+
+            // Close the file descriptor of the write end of the pipe, and make
+            // sure the read end is not inherited by launched processes.
             close(pipe_fds[1]);
+            fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC);
 
-            // Initialize storage for packets.
-            auto packet_storage = buffer<64 * 1024, char>{};
+            // Close the file descriptor of the read end of the report pipe.
+            // Note: Its write end is non-blocking, so that the executor never
+            // waits for the reports to be read. If the pipe is full, then the
+            // reports are discarded.
+            close(report_fds[0]);
 
-            // Define a function which reads from the pipe.
-            auto read_pipe = [pipe_fd = pipe_fds[0]](auto& range) -> bool {
-                // Read data.
-                auto n = ssize_t{};
-                while((n = read(pipe_fd, range.data(), range.size())) == -1) {
-                    if(errno != EINTR) {
-                        return false;
-                    }
-                }
+            // Initialize launch attributes.
+            auto attributes = launch_attributes{};
 
-                // If the pipe has been closed, then read failed.
-                if(n == 0) {
-                    return false;
-                }
+            // Initialize storage for packets.
+            // Note: The storage is large enough to hold at least one
+            // complete packet after a partially read packet is moved to its
+            // beginning.
+            using u16_storage = buffer<integer_size<std::uint16_t>>;
 
-                // Read succeeded.
-                return true;
-            };
+            auto packet_storage = buffer<
+                2 * (u16_storage::static_size() + command_size_max), char>{};
 
             // Read the pipe and execute the commands.
-            for(auto packet_size = size_t{}; true;) {
-                // Read packet size.
-                using u16_storage = buffer<integer_size<std::uint16_t>>;
-                if(auto size_storage = u16_storage{}; read_pipe(size_storage)) {
-                    packet_size = buffer_to_int<std::uint16_t>(size_storage);
-                } else {
-                    break;
-                }
-
-                // Obtain command storage.
-                auto command = std::span{packet_storage}.first(packet_size);
-                if(command.empty()) {
-                    continue;
+            for(auto head = size_t{}, tail = size_t{}, id = size_t{}; true;) {
+                // Read as much data as the storage can hold.
+                auto n = ssize_t{};
+                while((n = read(pipe_fds[0], packet_storage.data() + tail,
+                                packet_storage.size() - tail)) == -1) {
+                    if(errno != EINTR) {
+                        break;
+                    }
                 }
 
-                // Read the command.
-                if(!read_pipe(command)) {
+                // If the pipe has been closed, then stop.
+                if(n <= 0) {
                     break;
                 }
 
-                // Discard invalid command.
-                if(command.back() != '\0') {
-                    continue;
-                }
-
-                // Execute the command. Fork for the first time.
-                if(auto pid = fork(); pid == 0) {
-                    // Fork: the following code is only executed in the child
-                    // process.
-
-                    // Close the file descriptor of the read end of the pipe.
-                    close(pipe_fds[0]);
+                tail += static_cast<size_t>(n);
 
-                    // Initialize storage for arguments.
-                    char* argument_storage[256] = {};
+                // Execute all complete packets.
+                while((tail - head) >= u16_storage::static_size()) {
+                    // Read packet size.
+                    auto size_storage = u16_storage{};
+                    std::memcpy(size_storage.data(),
+                                packet_storage.data() + head,
+                                size_storage.size());
 
-                    // Initialize arguments.
-                    auto arguments = std::span{
-                        argument_storage, std::size(argument_storage) - 1};
+                    auto packet_size =
+                        buffer_to_int<std::uint16_t>(size_storage);
 
-                    for(auto offset = size_t{}; auto& argument : arguments) {
-                        offset += //
-                            std::strlen(argument =
-                                            packet_storage.data() + offset) +
-                            1;
-
-                        if(offset == packet_size) {
-                            break;
-                        }
+                    // Make sure the packet is complete.
+                    if((tail - head - size_storage.size()) < packet_size) {
+                        break;
                     }
 
-                    // Reset signal handlers.
-                    signal(SIGALRM, SIG_DFL);
-                    signal(SIGCHLD, SIG_DFL);
-                    signal(SIGPIPE, SIG_DFL);
-                    signal(SIGQUIT, SIG_DFL);
-                    signal(SIGTERM, SIG_DFL);
-
-                    signal(SIGHUP, SIG_DFL);
-                    signal(SIGINT, SIG_DFL);
+                    // Obtain the command and skip the packet.
+                    auto command = std::span{packet_storage}.subspan(
+                        head + size_storage.size(), packet_size);
 
-                    // Fork for the second time.
-                    if(fork() == 0) {
-                        // Fork: the following code is only executed in the
-                        // child process.
+                    head += size_storage.size() + packet_size;
 
-                        // Set SID.
-                        setsid();
+                    // Execute the command, if it is valid.
+                    auto report = execution_report{
+                        .pid = -1,
+                        .error = EINVAL,
+                        .spawn_time = std::chrono::steady_clock::now()
+                                          .time_since_epoch()};
 
-                        // Execute the command.
-                        execvp(arguments[0], arguments.data());
+                    if(!(command.empty()) && (command.back() == '\0')) {
+                        report = launch(attributes, command);
                     }
 
-                    // Exit the program.
-                    std::exit(EXIT_SUCCESS);
-                } else if(pid != -1) {
-                    // Wait for child process.
-                    while(waitpid(pid, nullptr, 0) == -1) {
+                    // Report the result.
+                    report.id = id++;
+                    while(write(report_fds[1], &report, sizeof(report)) ==
+                          -1) {
                         if(errno != EINTR) {
                             break;
                         }
                     }
                 }
+
+                // Move partially read packet to the beginning of the storage.
+                std::memmove(packet_storage.data(),
+                             packet_storage.data() + head, tail - head);
+
+                tail -= head;
+                head = 0;
             }
 
-            // Close the file descriptor of the read end of the pipe.
+            // Close the file descriptors of the pipes.
             close(pipe_fds[0]);
+            close(report_fds[1]);
 
             // Exit the program.
             std::exit(EXIT_SUCCESS);
@@ -270,11 +397,13 @@ run_executor_process() -> pipe_endpoint {
             break;
     }
 
-    // Close the file descriptor of the read end of the pipe.
+    // Close the file descriptors of the ends of the pipes which are used by
+    // the executor.
     close(pipe_fds[0]);
+    close(report_fds[1]);
 
-    // Return write end of the pipe.
-    return pipe_fds[1];
+    // Return write end of the command pipe and read end of the report pipe.
+    return {pipe_fds[1], report_fds[0]};
 }
 
 } // namespace rose
@@ -6,13 +6,68 @@
 #ifndef H_CAEA089AEB44440FA6700327664226E8
 #define H_CAEA089AEB44440FA6700327664226E8
 
-#include "ipc.hh"
-
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <string_view>
 
 namespace rose {
 
+////////////////////////////////////////////////////////////////////////////////
+// Standard integer type.
+////////////////////////////////////////////////////////////////////////////////
+
+using std::size_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// Execution result.
+////////////////////////////////////////////////////////////////////////////////
+
+enum struct execution_result { failure, success };
+
+////////////////////////////////////////////////////////////////////////////////
+// Command initialization interface.
+////////////////////////////////////////////////////////////////////////////////
+
+// Note: Maximum size of the command, including its terminating null
+// character. The size must fit in the 16-bit header of the packet.
+constexpr auto command_size_max = size_t{64 * 1024 - 1};
+
+// Writes the command to the given storage, replacing its contents. Unescaped
+// spaces separate the arguments, and are replaced with null characters.
+// Returns false if the command is empty or too long.
+auto
+initialize_command(std::u8string_view string, std::u8string& command) -> bool;
+
+////////////////////////////////////////////////////////////////////////////////
+// Execution report. Describes the result of the launch of a command by the
+// executor process.
+////////////////////////////////////////////////////////////////////////////////
+
+struct execution_report {
+    // Sequence number of the command. Commands are numbered from zero in the
+    // order of execution requests.
+    std::uint64_t id;
+
+    // ID of the launched process, or -1 on failure.
+    int pid;
+
+    // Error code (zero on success).
+    int error;
+
+    // Moment the launch has started, as the time since the epoch of
+    // std::chrono::steady_clock.
+    // Note: The clock is monotonic system-wide, so the moment can be compared
+    // with the times which are obtained by other processes.
+    std::chrono::nanoseconds spawn_time;
+
+    // Time elapsed between the start of the launch and the moment the process
+    // has executed the command (or has failed to do so).
+    std::chrono::nanoseconds latency;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Unix pipe endpoint.
 ////////////////////////////////////////////////////////////////////////////////
@@ -22,7 +77,7 @@ struct pipe_endpoint {
     // Construction/destruction.
     ////////////////////////////////////////////////////////////////////////////
 
-    pipe_endpoint(int fd);
+    pipe_endpoint(int fd, int report_fd = -1);
     ~pipe_endpoint();
 
     pipe_endpoint(pipe_endpoint const&) = delete;
@@ -46,26 +101,46 @@ struct pipe_endpoint {
         return this->fd_;
     }
 
-private:
-    int fd_;
-};
+    ////////////////////////////////////////////////////////////////////////////
+    // Accessors.
+    ////////////////////////////////////////////////////////////////////////////
 
-////////////////////////////////////////////////////////////////////////////////
-// Execution result.
-////////////////////////////////////////////////////////////////////////////////
+    // Returns the file descriptor of the pipe which delivers execution
+    // reports, or -1 if there is no such pipe. The descriptor is non-blocking.
+    auto
+    report_fd() const noexcept -> int {
+        return this->report_fd_;
+    }
 
-enum struct execution_result { failure, success };
+    ////////////////////////////////////////////////////////////////////////////
+    // Execution interface.
+    ////////////////////////////////////////////////////////////////////////////
+
+    friend auto
+    execute(pipe_endpoint& pipe, std::u8string_view string)
+        -> execution_result;
+
+private:
+    int fd_, report_fd_;
+
+    // Storage for the command which is being sent.
+    std::u8string command_;
+};
 
 ////////////////////////////////////////////////////////////////////////////////
 // Execution interface.
 ////////////////////////////////////////////////////////////////////////////////
 
 auto
-execute(ipc_client& client, std::u8string_view string) -> execution_result;
+execute(pipe_endpoint& pipe, std::u8string_view string) -> execution_result;
 
+// Reads all execution reports which are available without blocking, and
+// invokes the given function for each of them. Returns false if the reports
+// can no longer be received.
 auto
-execute(pipe_endpoint const& pipe, std::u8string_view string)
-    -> execution_result;
+receive_execution_reports(pipe_endpoint const& pipe,
+                          std::function<void(execution_report const&)> f)
+    -> bool;
 
 auto
 run_executor_process() -> pipe_endpoint;
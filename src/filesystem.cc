@@ -5,8 +5,33 @@
 //
 #include "filesystem.hh"
 
+#include <cstdlib>
+#include <utility>
+
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
 namespace rose::filesystem {
 
+////////////////////////////////////////////////////////////////////////////////
+// Path query interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+obtain_xdg_path(char const* variable, char const* fallback, char const* name)
+    -> std::filesystem::path {
+    if(auto x = std::getenv(variable); (x != nullptr) && (*x != '\0')) {
+        return std::filesystem::path{x} / "rosewm" / name;
+    }
+
+    if(auto x = std::getenv("HOME"); x != nullptr) {
+        return std::filesystem::path{x} / fallback / "rosewm" / name;
+    }
+
+    return {};
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // File size query interface implementation.
 ////////////////////////////////////////////////////////////////////////////////
@@ -57,4 +82,98 @@ read_string(std::filesystem::path path) -> std::string {
     return {};
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Data writing interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+write(std::filesystem::path path,
+      std::initializer_list<std::span<unsigned char const>> chunks) -> bool {
+    // Obtain a path to the temporary file.
+    auto path_tmp = path;
+    path_tmp += ".tmp." + std::to_string(getpid());
+
+    // Write the data to the temporary file.
+    if(auto file = file_stream{std::fopen(path_tmp.c_str(), "wb")}; file) {
+        auto is_written = true;
+        for(auto chunk : chunks) {
+            if(!(chunk.empty())) {
+                is_written = is_written &&
+                             (std::fwrite(chunk.data(), chunk.size(), 1,
+                                          file.get()) == 1);
+            }
+        }
+
+        if(is_written && (std::fflush(file.get()) == 0)) {
+            // Replace the file.
+            if(file.reset(); std::rename(path_tmp.c_str(), path.c_str()) == 0) {
+                return true;
+            }
+        }
+    }
+
+    // On error, remove the temporary file.
+    std::remove(path_tmp.c_str());
+    return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Read-only memory mapping of a file. Construction/destruction implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+file_mapping::file_mapping() noexcept : address_{}, size_{} {
+}
+
+file_mapping::file_mapping(std::filesystem::path path) : file_mapping{} {
+    // Open the file.
+    auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd == -1) {
+        return;
+    }
+
+    // Map its contents.
+    if(auto size = obtain_file_size(path); size != 0) {
+        if(auto address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+           address != MAP_FAILED) {
+            this->address_ = address;
+            this->size_ = size;
+        }
+    }
+
+    // Note: The mapping remains valid after the file is closed.
+    close(fd);
+}
+
+file_mapping::file_mapping(file_mapping&& other) noexcept
+    : address_{std::exchange(other.address_, nullptr)}
+    , size_{std::exchange(other.size_, 0)} {
+}
+
+file_mapping::~file_mapping() {
+    if(this->address_ != nullptr) {
+        munmap(this->address_, this->size_);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Read-only memory mapping of a file. Assignment operator implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+file_mapping::operator=(file_mapping other) noexcept -> file_mapping& {
+    std::swap(this->address_, other.address_);
+    std::swap(this->size_, other.size_);
+
+    return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Read-only memory mapping of a file. Accessors implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+file_mapping::data() const noexcept -> std::span<unsigned char const> {
+    return {static_cast<unsigned char const*>(this->address_), this->size_};
+}
+
 } // namespace rose::filesystem
@@ -9,8 +9,10 @@
 #include <cstddef>
 #include <cstdio>
 #include <filesystem>
+#include <initializer_list>
 #include <limits>
 #include <memory>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -38,6 +40,19 @@ using file_closer = decltype([](std::FILE* file) {
 
 using file_stream = std::unique_ptr<std::FILE, detail::file_closer>;
 
+////////////////////////////////////////////////////////////////////////////////
+// Path query interface.
+////////////////////////////////////////////////////////////////////////////////
+
+// Obtains a path to the file with the given name in one of the base
+// directories defined by the XDG Base Directory Specification: either in the
+// directory specified by the given environment variable, or in the given
+// fallback directory relative to the home directory. Returns an empty path if
+// neither directory is known.
+auto
+obtain_xdg_path(char const* variable, char const* fallback, char const* name)
+    -> std::filesystem::path;
+
 ////////////////////////////////////////////////////////////////////////////////
 // File size query interface.
 ////////////////////////////////////////////////////////////////////////////////
@@ -55,6 +70,58 @@ read(std::filesystem::path path) -> std::vector<unsigned char>;
 auto
 read_string(std::filesystem::path path) -> std::string;
 
+////////////////////////////////////////////////////////////////////////////////
+// Data writing interface.
+////////////////////////////////////////////////////////////////////////////////
+
+// Writes the concatenation of the given chunks of data to the file. The file is
+// replaced atomically: it either contains all of the data, or is left intact.
+auto
+write(std::filesystem::path path,
+      std::initializer_list<std::span<unsigned char const>> chunks) -> bool;
+
+////////////////////////////////////////////////////////////////////////////////
+// Read-only memory mapping of a file.
+////////////////////////////////////////////////////////////////////////////////
+
+struct file_mapping {
+    ////////////////////////////////////////////////////////////////////////////
+    // Construction/destruction.
+    ////////////////////////////////////////////////////////////////////////////
+
+    file_mapping() noexcept;
+
+    // Maps the whole file. On error, constructs an empty mapping.
+    file_mapping(std::filesystem::path path);
+
+    file_mapping(file_mapping const&) = delete;
+    file_mapping(file_mapping&& other) noexcept;
+
+    ~file_mapping();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Assignment operator.
+    ////////////////////////////////////////////////////////////////////////////
+
+    auto
+    operator=(file_mapping other) noexcept -> file_mapping&;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Accessors.
+    ////////////////////////////////////////////////////////////////////////////
+
+    auto
+    data() const noexcept -> std::span<unsigned char const>;
+
+private:
+    ////////////////////////////////////////////////////////////////////////////
+    // Data members.
+    ////////////////////////////////////////////////////////////////////////////
+
+    void* address_;
+    size_t size_;
+};
+
 } // namespace rose::filesystem
 
 #endif // H_DFE3E7DAE9B04E21A2C77858193C3024
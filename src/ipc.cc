@@ -5,11 +5,18 @@
 //
 #include "buffer.hh"
 #include "ipc.hh"
+#include "tracing.hh"
 
 #include <asio.hpp>
+#include <SDL.h>
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <chrono>
+#include <cstring>
+#include <memory>
 #include <thread>
-#include <map>
+#include <vector>
 
 namespace rose {
 using namespace std::literals::chrono_literals;
@@ -27,6 +34,89 @@ using ipc_socket = asio::local::stream_protocol::socket;
 
 using ipc_packet_storage = buffer<8192>;
 
+////////////////////////////////////////////////////////////////////////////////
+// Lock-free queue of outgoing IPC packets. Packets can be pushed by any
+// thread, but only one thread can pop them.
+////////////////////////////////////////////////////////////////////////////////
+
+struct ipc_packet_queue {
+    ////////////////////////////////////////////////////////////////////////////
+    // Queue node. Contains the packet with its size header.
+    ////////////////////////////////////////////////////////////////////////////
+
+    struct node {
+        node* next;
+        std::vector<unsigned char> bytes;
+    };
+
+    using node_list = std::vector<std::unique_ptr<node>>;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Construction/destruction.
+    ////////////////////////////////////////////////////////////////////////////
+
+    ipc_packet_queue() = default;
+
+    ipc_packet_queue(ipc_packet_queue const&) = delete;
+    ipc_packet_queue(ipc_packet_queue&&) = delete;
+
+    ~ipc_packet_queue() {
+        if(auto nodes = node_list{}; true) {
+            this->pop_all(nodes);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Assignment operators.
+    ////////////////////////////////////////////////////////////////////////////
+
+    auto
+    operator=(ipc_packet_queue const&) = delete;
+
+    auto
+    operator=(ipc_packet_queue&&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Queue interface.
+    ////////////////////////////////////////////////////////////////////////////
+
+    void
+    push(std::unique_ptr<node> x) noexcept {
+        auto ptr = x.release();
+        ptr->next = this->head.load(std::memory_order_relaxed);
+
+        while(!(this->head.compare_exchange_weak(ptr->next, ptr,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed))) {
+        }
+    }
+
+    // Removes all packets from the queue, and appends them to the given list
+    // in the order in which they have been pushed.
+    void
+    pop_all(node_list& result) {
+        // Note: The queue stores packets in reverse order.
+        auto const n = result.size();
+        for(auto ptr = this->head.exchange(nullptr, std::memory_order_acquire);
+            ptr != nullptr; ptr = ptr->next) {
+            result.emplace_back(ptr);
+        }
+
+        std::reverse(result.begin() + n, result.end());
+    }
+
+    auto
+    is_empty() const noexcept -> bool {
+        return (this->head.load() == nullptr);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Data members.
+    ////////////////////////////////////////////////////////////////////////////
+
+    std::atomic<node*> head{nullptr};
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // IPC client state.
 ////////////////////////////////////////////////////////////////////////////////
@@ -42,10 +132,96 @@ struct ipc_client_data {
     ipc_endpoint endpoint;
     ipc_socket socket{context};
 
+    // Queue of outgoing packets.
+    ipc_packet_queue tx_queue;
+
     // Flags.
-    std::atomic_bool is_tx_active;
+    std::atomic_bool is_connected, is_tx_active;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// Request delivery interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+void
+push_requests(struct shared_state const& state, request_set requests) {
+    if(requests != 0) {
+        auto event = SDL_Event{.type = state.event_idx};
+        event.user.code = static_cast<Sint32>(requests);
+
+        SDL_PushEvent(&event);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Packet receiving logic. Reads the socket in chunks, and processes all
+// complete packets which have been read. Requests produced by the packets of
+// each chunk are delivered to the main thread as one set.
+////////////////////////////////////////////////////////////////////////////////
+
+static auto
+receive_packets(struct shared_state& state, ipc_socket& socket,
+                auto process_packet) -> asio::awaitable<void> {
+    using u16_storage = buffer<integer_size<std::uint16_t>>;
+
+    // Initialize storage for packets.
+    // Note: The storage is large enough to hold at least one complete packet
+    // after a partially read packet is moved to its beginning.
+    static constexpr auto packet_size_max = ipc_packet_storage::static_size();
+
+    auto storage =
+        buffer<2 * (u16_storage::static_size() + packet_size_max)>{};
+
+    for(auto head = size_t{}, tail = size_t{};;) {
+        // Read as much data as the storage can hold.
+        tail += co_await socket.async_read_some(
+            asio::buffer(storage.data() + tail, storage.size() - tail),
+            asio::use_awaitable);
+
+        trace(trace_event::ipc_receive);
+
+        // Process all complete packets.
+        auto requests = request_set{};
+        while((tail - head) >= u16_storage::static_size()) {
+            // Read packet size.
+            auto size_storage = u16_storage{};
+            std::ranges::copy(
+                std::span{storage}.subspan(head, size_storage.size()),
+                size_storage.data());
+
+            auto packet_size =
+                size_t{buffer_to_int<std::uint16_t>(size_storage)};
+
+            if(packet_size > packet_size_max) {
+                co_return;
+            }
+
+            // Make sure the packet is complete.
+            if((tail - head - size_storage.size()) < packet_size) {
+                break;
+            }
+
+            // Process the packet.
+            requests = process_packet(
+                requests,
+                std::span{storage}.subspan(
+                    head + size_storage.size(), packet_size));
+
+            head += size_storage.size() + packet_size;
+        }
+
+        // Deliver the requests.
+        push_requests(state, requests);
+
+        // Move partially read packet to the beginning of the storage.
+        std::ranges::copy(std::span{storage}.subspan(head, tail - head),
+                          storage.data());
+
+        tail -= head;
+        head = 0;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Dispatcher IPC client execution logic.
 ////////////////////////////////////////////////////////////////////////////////
@@ -53,34 +229,52 @@ struct ipc_client_data {
 static auto
 run_dispatcher_client(struct ipc_client_data& data, std::chrono::seconds dt)
     -> asio::awaitable<void> {
+    // Define the table of IPC commands, indexed by the first byte of the
+    // command.
+    static constexpr auto command_table = [] {
+        struct {
+            bool is_valid;
+            enum request request;
+        } table[256] = {};
+
+        table[0x00] = {true, request::prompt_normal};
+        table[0x01] = {true, request::prompt_privileged};
+        table[0x02] = {true, request::reload_database};
+
+        return std::to_array(table);
+    }();
+
     // Define packet processing function.
     static auto process_packet = //
-        [](struct shared_state& state, auto packet) {
-            // Define IPC command type.
-            using ipc_command = buffer<64>;
-
-            // Define the map of IPC commands.
-            static std::map<ipc_command, request> command_map = {
-                {{0x00}, request::prompt_normal},
-                {{0x01}, request::prompt_privileged},
-                {{0x02}, request::reload_database}};
+        [](request_set requests, std::span<unsigned char const> packet) {
+            // Define the size of IPC command.
+            static constexpr auto command_size = size_t{64};
 
             // Process IPC commands from the packet.
-            auto event = SDL_Event{.type = state.event_idx};
-            for(auto command = ipc_command{};
-                packet.size() >= command.size();) {
-                // Obtain current command.
-                std::ranges::copy(packet.first(command.size()), command.data());
-
-                // Shrink the packet.
-                packet = packet.subspan(command.size());
+            for(; packet.size() >= command_size;
+                packet = packet.subspan(command_size)) {
+                // Make sure all bytes except the first one are zero.
+                // Note: The bytes are checked eight at a time.
+                std::uint64_t words[command_size / sizeof(std::uint64_t)];
+                std::memcpy(words, packet.data(), command_size);
+
+                words[0] &= ((std::endian::native == std::endian::little)
+                                 ? ~std::uint64_t{0xFF}
+                                 : ~(std::uint64_t{0xFF} << 56));
+
+                auto x = std::uint64_t{};
+                for(auto word : words) {
+                    x |= word;
+                }
 
                 // Process the command.
-                if(command_map.contains(command)) {
-                    event.user.code = static_cast<int>(command_map[command]);
-                    SDL_PushEvent(&event);
+                if(auto const& entry = command_table[packet[0]];
+                   (x == 0) && entry.is_valid) {
+                    requests = add_request(requests, entry.request);
                 }
             }
+
+            return requests;
         };
 
     try {
@@ -101,37 +295,16 @@ run_dispatcher_client(struct ipc_client_data& data, std::chrono::seconds dt)
         }
 
         // The server is ready to receive commands.
-        data.is_tx_active = false;
+        data.is_connected = true;
 
         // Read packets.
-        auto packet_storage = ipc_packet_storage{};
-        for(auto packet_size = size_t{};;) {
-            using u16_storage = buffer<integer_size<std::uint16_t>>;
-
-            // Read packet size.
-            auto size_storage = packet_storage.view_as<u16_storage>();
-            co_await asio::async_read(
-                data.socket,
-                asio::buffer(size_storage.data(), size_storage.size()),
-                asio::use_awaitable);
-
-            if(packet_size = buffer_to_int<std::uint16_t>(size_storage);
-               packet_size > packet_storage.size()) {
-                break;
-            }
-
-            // Read packet data.
-            co_await asio::async_read(
-                data.socket, asio::buffer(packet_storage.data(), packet_size),
-                asio::use_awaitable);
-
-            // Process the packet.
-            process_packet(
-                data.state, std::span{packet_storage}.first(packet_size));
-        }
+        co_await receive_packets(data.state, data.socket, process_packet);
     } catch(...) {
     }
 
+    // The server can no longer receive commands.
+    data.is_connected = false;
+
     // Restart.
     if(data.state.is_program_running) {
         asio::co_spawn( //
@@ -140,35 +313,41 @@ run_dispatcher_client(struct ipc_client_data& data, std::chrono::seconds dt)
 }
 
 static auto
-send_dispatcher_packet(struct ipc_client_data& data, auto packet)
-    -> asio::awaitable<void> {
-    // Start the transmission.
-    if(data.is_tx_active.exchange(true)) {
-        co_return;
-    }
+run_dispatcher_writer(struct ipc_client_data& data) -> asio::awaitable<void> {
+    // Initialize storage for the packets which are being sent.
+    auto packets = ipc_packet_queue::node_list{};
+    auto buffers = std::vector<asio::const_buffer>{};
+
+    while(true) {
+        // Obtain all queued packets.
+        packets.clear();
+        data.tx_queue.pop_all(packets);
+
+        // If there are no packets, then end the transmission.
+        if(packets.empty()) {
+            data.is_tx_active = false;
+
+            // Note: Packets could have been queued after the queue has been
+            // found empty, but before the transmission has ended. In this case
+            // either the transmission continues, or another writer is started.
+            if(data.tx_queue.is_empty() || data.is_tx_active.exchange(true)) {
+                co_return;
+            }
 
-    try {
-        // Write packet size.
-        if(true) {
-            auto size_storage =
-                int_to_buffer(static_cast<std::uint16_t>(packet.size));
-
-            co_await async_write( //
-                data.socket,
-                asio::buffer(size_storage.data(), size_storage.size()),
-                asio::use_awaitable);
+            continue;
         }
 
-        // Write packet data.
-        co_await async_write( //
-            data.socket, asio::buffer(packet.storage.data(), packet.size),
-            asio::use_awaitable);
+        // Write the packets with a single gathered write.
+        buffers.clear();
+        for(auto& packet : packets) {
+            buffers.push_back(asio::buffer(packet->bytes));
+        }
 
-    } catch(...) {
+        try {
+            co_await async_write(data.socket, buffers, asio::use_awaitable);
+        } catch(...) {
+        }
     }
-
-    // End the transmission.
-    data.is_tx_active = false;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -180,11 +359,16 @@ run_status_client(struct ipc_client_data& data, std::chrono::seconds dt)
     -> asio::awaitable<void> {
     // Define packet processing function.
     static auto process_packet = //
-        [](struct shared_state& state, auto packet) {
+        [](request_set requests, std::span<unsigned char const> packet) {
             // Define the type of the status message which notifies of the theme
             // update.
             static constexpr auto status_type_theme = 3;
 
+            // Define the types of the status messages which notify of the
+            // initialization and destruction of outputs.
+            static constexpr auto status_type_output_initialized = 6;
+            static constexpr auto status_type_output_destroyed = 7;
+
             // Define the size of the server state.
             static constexpr auto server_state_size = size_t{4};
 
@@ -215,19 +399,20 @@ run_status_client(struct ipc_client_data& data, std::chrono::seconds dt)
                 // Process the next status message depending on its type.
                 if(auto type = packet[0]; type < std::size(data_sizes)) {
                     // Request theme update, if needed.
-                    if(auto event = SDL_Event{.type = state.event_idx};
-                       type == status_type_theme) {
-                        // Construct the SDL event.
-                        event.user.code =
-                            static_cast<int>(request::reload_theme);
-
-                        // Queue the event.
-                        SDL_PushEvent(&event);
+                    if(type == status_type_theme) {
+                        requests = add_request(requests, request::reload_theme);
 
                         // Do nothing else.
                         break;
                     }
 
+                    // Request update of the outputs, if needed.
+                    if((type == status_type_output_initialized) ||
+                       (type == status_type_output_destroyed)) {
+                        requests =
+                            add_request(requests, request::update_outputs);
+                    }
+
                     // Shrink the packet.
                     packet = packet.subspan(
                         std::min(packet.size(), data_sizes[type]));
@@ -235,6 +420,8 @@ run_status_client(struct ipc_client_data& data, std::chrono::seconds dt)
                     break;
                 }
             }
+
+            return requests;
         };
 
     try {
@@ -255,30 +442,7 @@ run_status_client(struct ipc_client_data& data, std::chrono::seconds dt)
         }
 
         // Read packets.
-        auto packet_storage = ipc_packet_storage{};
-        for(auto packet_size = size_t{};;) {
-            using u16_storage = buffer<integer_size<std::uint16_t>>;
-
-            // Read packet size.
-            auto size_storage = packet_storage.view_as<u16_storage>();
-            co_await asio::async_read(
-                socket, asio::buffer(size_storage.data(), size_storage.size()),
-                asio::use_awaitable);
-
-            if(packet_size = buffer_to_int<std::uint16_t>(size_storage);
-               packet_size > packet_storage.size()) {
-                break;
-            }
-
-            // Read packet data.
-            co_await asio::async_read(
-                socket, asio::buffer(packet_storage.data(), packet_size),
-                asio::use_awaitable);
-
-            // Process the packet.
-            process_packet(
-                data.state, std::span{packet_storage}.first(packet_size));
-        }
+        co_await receive_packets(data.state, socket, process_packet);
     } catch(...) {
     }
 
@@ -289,6 +453,32 @@ run_status_client(struct ipc_client_data& data, std::chrono::seconds dt)
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// File descriptor watching logic.
+////////////////////////////////////////////////////////////////////////////////
+
+static auto
+run_watch(struct ipc_client_data& data, int fd, std::function<bool()> f)
+    -> asio::awaitable<void> {
+    // Note: The descriptor does not own the file descriptor, so it must be
+    // released before destruction.
+    auto descriptor = asio::posix::stream_descriptor{data.context, fd};
+
+    try {
+        for(auto is_watching = true; is_watching;) {
+            // Wait for the file descriptor to become readable.
+            co_await descriptor.async_wait(
+                asio::posix::stream_descriptor::wait_read, asio::use_awaitable);
+
+            // Process its data.
+            is_watching = f();
+        }
+    } catch(...) {
+    }
+
+    descriptor.release();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // IPC client implementation details.
 ////////////////////////////////////////////////////////////////////////////////
@@ -300,30 +490,44 @@ struct ipc_client {
     // Construction/destruction.
     ////////////////////////////////////////////////////////////////////////////
 
-    ipc_client(struct shared_state& state)
-        : data{.state = state}, thread{[this]() {
-            // Obtain IPC endpoint address.
-            if(auto string = getenv("ROSE_IPC_ENDPOINT"); string != nullptr) {
-                data.endpoint = ipc_endpoint{string};
-            }
+    ipc_client(struct shared_state& state, enum ipc_client_mode mode)
+        : data{.state = state}, thread{} {
+        // Obtain IPC endpoint address.
+        if(auto string = getenv("ROSE_IPC_ENDPOINT"); string != nullptr) {
+            data.endpoint = ipc_endpoint{string};
+        }
 
-            try {
-                // Add work.
-                asio::co_spawn(data.context, run_dispatcher_client(data, 0s),
-                               asio::detached);
+        // Add work.
+        asio::co_spawn(
+            data.context, run_dispatcher_client(data, 0s), asio::detached);
 
-                asio::co_spawn(
-                    data.context, run_status_client(data, 0s), asio::detached);
+        asio::co_spawn(
+            data.context, run_status_client(data, 0s), asio::detached);
+
+        // In threaded mode, run event loop in a separate thread.
+        if(mode == ipc_client_mode::threaded) {
+            thread = std::jthread{[this]() {
+                this->run([this] { data.context.run(); });
+                return EXIT_SUCCESS;
+            }};
+        }
+    }
 
-                // Run event loop.
-                data.context.run();
-            } catch(...) {
-            }
+    ////////////////////////////////////////////////////////////////////////////
+    // Event loop execution interface.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Runs the given function which runs event loop.
+    // Note: If event loop fails, then program execution is stopped.
+    void
+    run(std::invocable auto f) {
+        try {
+            f();
+            return;
+        } catch(...) {
+        }
 
-            // Stop program execution.
-            data.state.is_program_running = false;
-            return EXIT_SUCCESS;
-        }} {
+        data.state.is_program_running = false;
     }
 
     ////////////////////////////////////////////////////////////////////////////
@@ -346,8 +550,9 @@ ipc_client_deleter::operator()(struct ipc_client* client) {
 ////////////////////////////////////////////////////////////////////////////////
 
 auto
-initialize_ipc_client(struct shared_state& state) -> ipc_client {
-    return ipc_client{new detail::ipc_client{state}};
+initialize_ipc_client(struct shared_state& state, enum ipc_client_mode mode)
+    -> ipc_client {
+    return ipc_client{new detail::ipc_client{state, mode}};
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -359,10 +564,27 @@ stop(ipc_client& client) {
     client->data.context.stop();
 }
 
+void
+poll(ipc_client& client) {
+    client->run([&data = client->data] { data.context.poll(); });
+}
+
+void
+run_for(ipc_client& client, std::chrono::milliseconds timeout) {
+    client->run([&data = client->data, timeout] {
+        // Wait for the first event, then process all the other events which
+        // are ready.
+        if(data.context.run_one_for(timeout) != 0) {
+            data.context.poll();
+        }
+    });
+}
+
 auto
 request_execution(ipc_client& client, std::span<char8_t const> command_and_args)
     -> bool {
-    if(client->data.is_tx_active) {
+    // Make sure the server is ready to receive commands.
+    if(!(client->data.is_connected)) {
         return false;
     }
 
@@ -376,20 +598,59 @@ request_execution(ipc_client& client, std::span<char8_t const> command_and_args)
         return false;
     }
 
-    // Initialize the packet.
-    struct {
-        ipc_packet_storage storage;
-        size_t size;
-    } packet = {.storage = {0x03}, .size = command_and_args.size() + 1};
-    std::ranges::copy(command_and_args, packet.storage.data() + 1);
+    // Initialize the packet: its size, the type of the request, and the
+    // command with its arguments.
+    auto packet = std::make_unique<ipc_packet_queue::node>();
+    if(auto& bytes = packet->bytes; true) {
+        auto size = int_to_buffer(
+            static_cast<std::uint16_t>(command_and_args.size() + 1));
+
+        bytes.reserve(size.size() + command_and_args.size() + 1);
+        bytes.assign(size.begin(), size.end());
+        bytes.push_back(0x03);
+        bytes.insert(
+            bytes.end(), command_and_args.begin(), command_and_args.end());
+    }
 
-    // Request packet transmission.
-    asio::post(client->data.context, [&data = client->data, packet] {
-        asio::co_spawn(
-            data.context, send_dispatcher_packet(data, packet), asio::detached);
-    });
+    // Queue the packet, and start the writer, if needed.
+    auto& data = client->data;
+    if(data.tx_queue.push(std::move(packet));
+       !(data.is_tx_active.exchange(true))) {
+        asio::post(data.context, [&data] {
+            asio::co_spawn(
+                data.context, run_dispatcher_writer(data), asio::detached);
+        });
+    }
 
     return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Execution interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+execute(ipc_client& client, std::u8string_view string) -> execution_result {
+    if(auto command = std::u8string{}; initialize_command(string, command)) {
+        if(request_execution(client, command)) {
+            return execution_result::success;
+        }
+    }
+
+    return execution_result::failure;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// File descriptor watching interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+void
+watch(ipc_client& client, int fd, std::function<bool()> f) {
+    asio::post(
+        client->data.context, [&data = client->data, fd, f = std::move(f)] {
+            asio::co_spawn(
+                data.context, run_watch(data, fd, f), asio::detached);
+        });
+}
+
 } // namespace rose
@@ -6,10 +6,14 @@
 #ifndef H_EED61A94ACC64B23AC54791921BFB9AD
 #define H_EED61A94ACC64B23AC54791921BFB9AD
 
+#include "execution.hh"
+
 #include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <span>
-#include <SDL.h>
 
 namespace rose {
 
@@ -21,21 +25,59 @@ enum struct request {
     prompt_normal,
     prompt_privileged,
     reload_database,
-    reload_theme
+    reload_theme,
+    report_launch_failure,
+    report_launch_success,
+    update_outputs
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// Set of requests. Requests are delivered to the main thread in sets, one set
+// per SDL user event (in the code of the event). Each request is represented
+// by one bit of the set.
+////////////////////////////////////////////////////////////////////////////////
+
+using request_set = unsigned;
+
+constexpr auto
+to_request_set(enum request x) noexcept -> request_set {
+    return (request_set{1} << static_cast<unsigned>(x));
+}
+
+// Adds the given request to the given set.
+// Note: Prompt requests replace each other, so that only the last one remains
+// in the set.
+constexpr auto
+add_request(request_set set, enum request x) noexcept -> request_set {
+    if((x == request::prompt_normal) || (x == request::prompt_privileged)) {
+        set &= ~(to_request_set(request::prompt_normal) |
+                 to_request_set(request::prompt_privileged));
+    }
+
+    return (set | to_request_set(x));
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Shared state.
 ////////////////////////////////////////////////////////////////////////////////
 
 struct shared_state {
     // SDL user event index.
-    Uint32 event_idx;
+    std::uint32_t event_idx;
 
     // Flags.
     std::atomic_bool is_program_running;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// Request delivery interface.
+////////////////////////////////////////////////////////////////////////////////
+
+// Queues an SDL user event which delivers the given set of requests to the
+// main thread. Does nothing if the set is empty.
+void
+push_requests(struct shared_state const& state, request_set requests);
+
 ////////////////////////////////////////////////////////////////////////////////
 // IPC client.
 ////////////////////////////////////////////////////////////////////////////////
@@ -57,12 +99,22 @@ struct ipc_client_deleter {
 using ipc_client =
     std::unique_ptr<detail::ipc_client, detail::ipc_client_deleter>;
 
+////////////////////////////////////////////////////////////////////////////////
+// IPC client mode. In threaded mode the client runs its event loop in a
+// separate thread. In integrated mode the event loop is run by the thread
+// which owns the client (see the event loop interface).
+////////////////////////////////////////////////////////////////////////////////
+
+enum struct ipc_client_mode { threaded, integrated };
+
 ////////////////////////////////////////////////////////////////////////////////
 // IPC client initialization interface.
 ////////////////////////////////////////////////////////////////////////////////
 
 auto
-initialize_ipc_client(struct shared_state& state) -> ipc_client;
+initialize_ipc_client(struct shared_state& state,
+                      enum ipc_client_mode mode = ipc_client_mode::threaded)
+    -> ipc_client;
 
 ////////////////////////////////////////////////////////////////////////////////
 // IPC client communication interface.
@@ -71,10 +123,43 @@ initialize_ipc_client(struct shared_state& state) -> ipc_client;
 void
 stop(ipc_client& client);
 
+////////////////////////////////////////////////////////////////////////////////
+// IPC client event loop interface (integrated mode only).
+////////////////////////////////////////////////////////////////////////////////
+
+// Processes all events which are ready, without blocking.
+void
+poll(ipc_client& client);
+
+// Waits for at least one event for the given amount of time, and processes
+// all events which are ready.
+void
+run_for(ipc_client& client, std::chrono::milliseconds timeout);
+
 auto
 request_execution(ipc_client& client, std::span<char8_t const> command_and_args)
     -> bool;
 
+////////////////////////////////////////////////////////////////////////////////
+// Execution interface.
+////////////////////////////////////////////////////////////////////////////////
+
+// Requests the execution of the given command string by the server.
+auto
+execute(ipc_client& client, std::u8string_view string) -> execution_result;
+
+////////////////////////////////////////////////////////////////////////////////
+// File descriptor watching interface.
+////////////////////////////////////////////////////////////////////////////////
+
+// Starts watching the given file descriptor in IPC client's thread. The given
+// function is invoked each time the file descriptor becomes readable, watching
+// stops when it returns false.
+// Note: The file descriptor is not owned by the client, and must remain valid
+// for the lifetime of the client.
+void
+watch(ipc_client& client, int fd, std::function<bool()> f);
+
 } // namespace rose
 
 #endif // H_EED61A94ACC64B23AC54791921BFB9AD
@@ -0,0 +1,155 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+#include "buffer.hh"
+#include "filesystem.hh"
+#include "launch_history.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numbers>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace rose {
+
+////////////////////////////////////////////////////////////////////////////////
+// Log format definitions.
+////////////////////////////////////////////////////////////////////////////////
+
+// Each record of the log consists of the launch time (in seconds since epoch),
+// the size of the command, and the command itself. All integers are stored in
+// little-endian byte order.
+using record_time_storage = buffer<integer_size<std::uint64_t>>;
+using record_size_storage = buffer<integer_size<std::uint16_t>>;
+
+static constexpr auto record_header_size =
+    (record_time_storage::static_size() + record_size_storage::static_size());
+
+// Maximum number of records in the log. When the log grows larger, only the
+// most recent half of its records are kept.
+static constexpr auto n_records_max = size_t{4096};
+
+// Decay rate of launch weights. Weight halves each week.
+static constexpr auto decay_rate = (std::numbers::ln2 / (7 * 24 * 3600));
+
+////////////////////////////////////////////////////////////////////////////////
+// Construction/destruction implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+launch_history::launch_history(std::filesystem::path path)
+    : path_{std::move(path)} {
+    // Read the log.
+    auto data = filesystem::read(this->path_);
+
+    // Process its records.
+    auto offsets = std::vector<size_t>{};
+    auto offset = size_t{};
+
+    while((data.size() - offset) >= record_header_size) {
+        // Read record's header.
+        auto time = record_time_storage{};
+        auto size = record_size_storage{};
+
+        std::copy_n(data.data() + offset, time.size(), time.data());
+        std::copy_n(
+            data.data() + offset + time.size(), size.size(), size.data());
+
+        // Stop at incomplete record.
+        auto command_size = size_t{buffer_to_int<std::uint16_t>(size)};
+        if((data.size() - offset - record_header_size) < command_size) {
+            break;
+        }
+
+        // Add the command.
+        this->add_(
+            std::u8string_view{reinterpret_cast<char8_t const*>(
+                                   data.data() + offset + record_header_size),
+                               command_size},
+            buffer_to_int<std::uint64_t>(time));
+
+        // Advance to the next record.
+        offsets.push_back(offset);
+        offset += record_header_size + command_size;
+    }
+
+    // Rewrite the log if it has grown too large, or if it ends with an
+    // incomplete record (which would corrupt subsequently appended records).
+    if((offsets.size() > n_records_max) || (offset != data.size())) {
+        auto first = size_t{};
+        if(offsets.size() > n_records_max) {
+            first = offsets[offsets.size() - (n_records_max / 2)];
+        }
+
+        filesystem::write(
+            this->path_, {std::span{data}.subspan(first, offset - first)});
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Modification interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+void
+launch_history::record(std::u8string_view command) {
+    // Make sure the command fits in a record.
+    if(command.empty() ||
+       (command.size() > std::numeric_limits<std::uint16_t>::max())) {
+        return;
+    }
+
+    // Obtain current time.
+    auto time = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count());
+
+    // Add the command to the table.
+    this->add_(command, time);
+
+    // Append the record to the log.
+    if(this->path_.empty()) {
+        return;
+    }
+
+    if(auto error = std::error_code{}; true) {
+        std::filesystem::create_directories(this->path_.parent_path(), error);
+    }
+
+    if(auto file =
+           filesystem::file_stream{std::fopen(this->path_.c_str(), "ab")};
+       file) {
+        auto time_storage = int_to_buffer(time);
+        auto size_storage =
+            int_to_buffer(static_cast<std::uint16_t>(command.size()));
+
+        std::fwrite(time_storage.data(), time_storage.size(), 1, file.get());
+        std::fwrite(size_storage.data(), size_storage.size(), 1, file.get());
+        std::fwrite(command.data(), command.size(), 1, file.get());
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Utility functions implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+void
+launch_history::add_(std::u8string_view command, std::uint64_t time) {
+    // Compute the score of a single launch at the given time.
+    auto x = decay_rate * static_cast<double>(time);
+
+    // Add it to the score of the command: log(exp(a) + exp(b)).
+    if(auto [i, is_inserted] =
+           this->scores_.try_emplace(std::u8string{command}, x);
+       !is_inserted) {
+        auto [a, b] = std::minmax(i->second, x);
+        i->second = b + std::log1p(std::exp(a - b));
+    }
+}
+
+} // namespace rose
@@ -0,0 +1,85 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+#ifndef H_4C0D8E2B7A5F41C6B3E19D6F2A8C7E05
+#define H_4C0D8E2B7A5F41C6B3E19D6F2A8C7E05
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace rose {
+
+////////////////////////////////////////////////////////////////////////////////
+// Standard integer type.
+////////////////////////////////////////////////////////////////////////////////
+
+using std::size_t;
+
+////////////////////////////////////////////////////////////////////////////////
+// History of launched commands. The history is stored in an append-only log
+// file, and is loaded into a table of frecency scores of the commands.
+//
+// Each launch contributes a unit of weight which decays exponentially over
+// time. Scores are stored on a logarithmic scale, shifted by the decay rate
+// times the launch time, so that the order of the scores does not change over
+// time, and they never have to be updated unless a command is launched.
+////////////////////////////////////////////////////////////////////////////////
+
+struct launch_history {
+    ////////////////////////////////////////////////////////////////////////////
+    // Construction/destruction.
+    ////////////////////////////////////////////////////////////////////////////
+
+    launch_history() = default;
+
+    // Loads the history from the given log file.
+    launch_history(std::filesystem::path path);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Modification interface.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Records the launch of the given command, and appends it to the log.
+    void
+    record(std::u8string_view command);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Accessors.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Returns the table of scores of all commands. Higher score means higher
+    // rank.
+    auto
+    scores() const noexcept
+        -> std::unordered_map<std::u8string, double> const& {
+        return this->scores_;
+    }
+
+private:
+    ////////////////////////////////////////////////////////////////////////////
+    // Utility functions.
+    ////////////////////////////////////////////////////////////////////////////
+
+    void
+    add_(std::u8string_view command, std::uint64_t time);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Data members.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Path to the log file.
+    std::filesystem::path path_;
+
+    // Scores of the commands.
+    std::unordered_map<std::u8string, double> scores_;
+};
+
+} // namespace rose
+
+#endif // H_4C0D8E2B7A5F41C6B3E19D6F2A8C7E05
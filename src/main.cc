@@ -11,12 +11,26 @@
 #include "rendering_text.hh"
 #include "rendering_theme.hh"
 #include "text_input.hh"
+#include "tracing.hh"
 #include "unicode.hh"
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include <sys/signalfd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <SDL.h>
+
 namespace rose {
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -68,26 +82,78 @@ using texture_deleter = decltype([](SDL_Texture* texture) {
 using texture = std::unique_ptr<SDL_Texture, detail::texture_deleter>;
 
 ////////////////////////////////////////////////////////////////////////////////
-// Font data reading utility function.
+// Self-closing file descriptor.
 ////////////////////////////////////////////////////////////////////////////////
 
+struct file_descriptor {
+    ////////////////////////////////////////////////////////////////////////////
+    // Construction/destruction.
+    ////////////////////////////////////////////////////////////////////////////
+
+    file_descriptor(int fd) noexcept : fd_{fd} {
+    }
+
+    ~file_descriptor() {
+        if(this->fd_ != -1) {
+            close(this->fd_);
+        }
+    }
+
+    file_descriptor(file_descriptor const&) = delete;
+    file_descriptor(file_descriptor&&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Assignment operators.
+    ////////////////////////////////////////////////////////////////////////////
+
+    auto
+    operator=(file_descriptor const&) = delete;
+
+    auto
+    operator=(file_descriptor&&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Conversion operator.
+    ////////////////////////////////////////////////////////////////////////////
+
+    operator int() const noexcept {
+        return this->fd_;
+    }
+
+private:
+    int fd_;
+};
+
+// Rounds the given texture dimension up to the size bucket which contains it,
+// so that small changes of the size do not require a new texture.
+constexpr auto
+snap_texture_size(int x) noexcept -> int {
+    constexpr auto bucket_size = 128;
+    return ((x + bucket_size - 1) / bucket_size) * bucket_size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Font path reading utility function.
+////////////////////////////////////////////////////////////////////////////////
+
+// Reads the list of font files (at most eight of them) from the first
+// configuration file which exists.
 auto
-read_font_data() -> std::vector<std::vector<unsigned char>> {
+read_font_paths() -> std::vector<std::filesystem::path> {
     // Obtain configuration paths.
     std::filesystem::path paths[] = {
         std::string{std::getenv("HOME")} + "/.config/rosewm/fonts",
         "/etc/rosewm/fonts"};
 
-    // Read fonts.
-    auto fonts = std::vector<std::vector<unsigned char>>{};
+    // Read font paths.
+    auto fonts = std::vector<std::filesystem::path>{};
     for(auto font_name = std::string{}; auto const& path : paths) {
         if(auto file = std::ifstream{path}; !file) {
             continue;
         } else {
-            for(std::getline(file, font_name); !(file.eof());) {
-                if(fonts.emplace_back(filesystem::read(font_name));
-                   fonts.size() > 7) {
-                    break;
+            while((fonts.size() != 8) && std::getline(file, font_name)) {
+                if(!(font_name.empty())) {
+                    fonts.emplace_back(font_name);
                 }
             }
         }
@@ -117,9 +183,45 @@ main() {
         return EXIT_FAILURE;
     }
 
+    // Block SIGUSR1, so that it can be received through a file descriptor.
+    // Note: This must be done before any other thread is started, since
+    // threads inherit the signal mask.
+    auto signals = sigset_t{};
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    // Open a file descriptor which receives SIGUSR1.
+    // Note: The file descriptor must outlive IPC client, since the client
+    // watches it.
+    auto signal_fd = rose::file_descriptor{
+        signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC)};
+
+    // Obtain font loading mode.
+    auto is_font_loading_lazy = false;
+    if(auto x = std::getenv("ROSE_DISPATCHER_FONT_LOADING");
+       (x != nullptr) && (std::string_view{x} == "lazy")) {
+        is_font_loading_lazy = true;
+    }
+
     // Initialize text rendering context.
+    // Note: In lazy font loading mode, font files are mapped into memory, and
+    // fallback fonts are opened only when they are needed.
     auto text_rendering_context = rose::text_rendering_context{};
-    if(auto fonts = rose::read_font_data(); true) {
+    if(auto paths = rose::read_font_paths(); is_font_loading_lazy) {
+        auto files = std::vector<rose::filesystem::file_mapping>{};
+        for(auto const& path : paths) {
+            files.emplace_back(path);
+        }
+
+        text_rendering_context = rose::initialize(
+            rose::text_rendering_context_parameters{.font_files = files});
+    } else {
+        auto fonts = std::vector<std::vector<unsigned char>>{};
+        for(auto const& path : paths) {
+            fonts.emplace_back(rose::filesystem::read(path));
+        }
+
         text_rendering_context = rose::initialize(
             rose::text_rendering_context_parameters{.fonts = fonts});
     }
@@ -155,75 +257,786 @@ main() {
     // Initialize window flags.
     auto is_window_visible = false, is_window_updated = true;
 
+    // Initialize standby flag. If set, then the frames which are kept rendered
+    // while the window is hidden must be rendered again.
+    auto is_standby_outdated = true;
+
     // Define functions for hiding and showing the window.
     auto show_window = [&]() {
         is_window_visible = is_window_updated = true;
         SDL_ShowWindow(window.get());
     };
 
-    auto hide_window = [&is_window_visible, &window]() {
+    auto hide_window = [&]() {
         is_window_visible = false;
+        is_standby_outdated = true;
         SDL_HideWindow(window.get());
     };
 
+    // Obtain rendering mode.
+    auto is_rendering_accelerated = false;
+    if(auto x = std::getenv("ROSE_DISPATCHER_RENDERER");
+       (x != nullptr) && (std::string_view{x} == "accelerated")) {
+        is_rendering_accelerated = true;
+    }
+
     // Create a renderer.
-    auto renderer = rose::renderer{
-        SDL_CreateRenderer(window.get(), -1, SDL_RENDERER_SOFTWARE)};
+    // Note: If accelerated renderer can not be created, then software renderer
+    // is used instead.
+    auto renderer = rose::renderer{};
+    if(is_rendering_accelerated) {
+        renderer.reset(
+            SDL_CreateRenderer(window.get(), -1, SDL_RENDERER_ACCELERATED));
+
+        is_rendering_accelerated = static_cast<bool>(renderer);
+    }
+
+    if(!renderer) {
+        renderer.reset(
+            SDL_CreateRenderer(window.get(), -1, SDL_RENDERER_SOFTWARE));
+    }
 
     if(!renderer) {
         return EXIT_FAILURE;
     }
 
-    // Initialize an empty texture.
+    // Initialize an empty glyph atlas texture.
+    // Note: In accelerated rendering mode, glyphs are drawn directly from the
+    // atlas as a batch of textured quads.
     struct {
         rose::texture handle;
         int w, h;
-    } texture = {};
+
+        // Maximum height of the texture.
+        int h_max;
+
+        // Pixels of the atlas, and their revision number.
+        std::vector<unsigned char> pixels;
+        unsigned long long revision;
+    } atlas = {.h_max = std::numeric_limits<int>::max()};
+
+    // Limit the height of the glyph atlas to the maximum height of a texture.
+    if(SDL_RendererInfo info = {};
+       is_rendering_accelerated &&
+       (SDL_GetRendererInfo(renderer.get(), &info) == 0) &&
+       (info.max_texture_height > 0)) {
+        atlas.h_max = info.max_texture_height;
+        rose::limit_glyph_atlas(text_rendering_context, atlas.h_max);
+    }
+
+    // Define the frame of a prompt.
+    // Note: While the window is hidden, the frames of both prompts are kept
+    // rendered at the last known size (warm standby), so that showing the
+    // prompt only presents a finished frame.
+    struct prompt_frame {
+        // Description of the frame.
+        // Note: If the composed text and its rendering parameters do not
+        // change, then the text is not laid out again.
+        struct {
+            std::u8string text;
+            int font_size, dpi, w, h;
+
+            // Revision of the glyph atlas which has been used for layout.
+            unsigned long long atlas_revision;
+        } description;
+
+        // Texture, which is used in software rendering mode.
+        // Note: Texture's size is snapped to the size bucket (it can be
+        // larger than the frame). Its pixels are also kept in memory, so that
+        // only the region which has been damaged by text rendering needs to be
+        // updated.
+        struct {
+            rose::texture handle;
+            int w, h;
+
+            // Pixels of the texture, and the region occupied by rendered
+            // text.
+            std::vector<unsigned char> pixels;
+            SDL_Rect text_rect;
+        } texture;
+
+        // Vertices and indices of glyph quads, which are used in accelerated
+        // rendering mode.
+        std::vector<SDL_Vertex> vertices;
+        std::vector<int> indices;
+    };
+
+    // Define the state of an output: the frames which have been rendered for
+    // the given display at the given DPI.
+    // Note: Glyphs, sized font faces, and layouts are cached by the text
+    // rendering context for each DPI, so only the frames need to be kept for
+    // each output. When the window moves to another output, the frames which
+    // have been rendered there are presented again without rendering.
+    struct output_state {
+        // Name and bounds of the display, and its effective DPI.
+        // Note: Displays are identified by their names and bounds, since
+        // their indices change when other displays are added or removed.
+        std::string display_name;
+        SDL_Rect display_bounds;
+        int dpi;
+
+        // Font size for which printable ASCII characters have been added to
+        // the glyph atlas at the output's DPI.
+        int atlas_font_size;
+
+        // Frames: one for each kind of prompt (normal and privileged).
+        struct prompt_frame frames[2];
+    };
+
+    // Initialize an empty list of output states, ordered from the least
+    // recently used to the most recently used.
+    // Note: When the list is full, the least recently used state is destroyed.
+    // When outputs are initialized or destroyed, the states of the displays
+    // which no longer exist are destroyed.
+    static constexpr auto n_outputs_max = size_t{4};
+
+    auto outputs = std::vector<output_state>{};
+    outputs.reserve(n_outputs_max);
+
+    // Initialize an empty buffer for the composed text, converted to UTF-32.
+    auto text_line = rose::utf32_string_buffer{};
 
     // Initialize text input.
     auto text_input = rose::text_input{};
 
+    // Obtain matching mode of the database.
+    auto matching_mode = rose::matching_mode::prefix;
+    if(auto x = std::getenv("ROSE_DISPATCHER_MATCHING");
+       (x != nullptr) && (std::string_view{x} == "fuzzy")) {
+        matching_mode = rose::matching_mode::fuzzy;
+    }
+
+    // Initialize database of executable files.
+    // Note: The database must outlive IPC client, since the client services the
+    // database's file descriptor.
+    auto database = rose::executables_database{matching_mode};
+
     // Initialize shared state.
     auto state = rose::shared_state{
         .event_idx = SDL_RegisterEvents(1), .is_program_running = true};
 
+    // Obtain event loop mode.
+    auto ipc_client_mode = rose::ipc_client_mode::threaded;
+    if(auto x = std::getenv("ROSE_DISPATCHER_EVENT_LOOP");
+       (x != nullptr) && (std::string_view{x} == "integrated")) {
+        ipc_client_mode = rose::ipc_client_mode::integrated;
+    }
+
+    // Initialize the list of commands which have been sent to the executor
+    // process, and have not been reported yet, along with their sequence
+    // numbers.
+    // Note: A command is recorded in launch history only when its successful
+    // launch has been reported.
+    struct pending_launch {
+        std::uint64_t id;
+        std::u8string command_string;
+    };
+
+    auto pending_launches = std::deque<pending_launch>{};
+    auto launch_id = std::uint64_t{};
+
+    // Initialize the list of reports which have been received, and have not
+    // been processed by the main thread yet.
+    // Note: The list must outlive IPC client, since the client receives the
+    // reports.
+    struct {
+        std::mutex mutex;
+        std::vector<rose::execution_report> list;
+    } launch_reports;
+
     // Initialize IPC client.
-    auto ipc_client = rose::initialize_ipc_client(state);
+    auto ipc_client = rose::initialize_ipc_client(state, ipc_client_mode);
 
-    // Initialize database of executable files.
-    auto database = rose::executables_database{};
+    // Keep the database up to date with the changes in its directories.
+    if(auto fd = database.watch(); fd != -1) {
+        rose::watch(ipc_client, fd,
+                    [&database] { return database.process_watch_events(); });
+    }
+
+    // Receive execution reports from the executor process.
+    // Note: Reports are received in IPC client's thread, and are forwarded to
+    // the main thread.
+    if(auto fd = pipe.report_fd(); fd != -1) {
+        rose::watch(ipc_client, fd, [&pipe, &state, &launch_reports] {
+            return rose::receive_execution_reports(
+                pipe, [&](rose::execution_report const& report) {
+                    // Note: Failed launches are traced with their error
+                    // codes.
+                    rose::trace(rose::trace_event::launch,
+                                rose::trace_clock::time_point{
+                                    std::chrono::duration_cast<
+                                        rose::trace_clock::duration>(
+                                        report.spawn_time)},
+                                report.latency, report.error);
+
+                    if(auto lock = std::lock_guard{launch_reports.mutex};
+                       true) {
+                        launch_reports.list.push_back(report);
+                    }
+
+                    rose::push_requests(
+                        state, rose::to_request_set(
+                                   (report.error != 0)
+                                       ? rose::request::report_launch_failure
+                                       : rose::request::report_launch_success));
+                });
+        });
+    }
+
+    // Dump the trace upon receiving SIGUSR1.
+    if(signal_fd != -1) {
+        rose::watch(ipc_client, signal_fd, [fd = int{signal_fd}] {
+            // Read all pending signals, and dump the trace once.
+            auto is_signaled = false;
+            for(signalfd_siginfo x; read(fd, &x, sizeof(x)) > 0;) {
+                is_signaled = true;
+            }
+
+            if(is_signaled) {
+                rose::dump_trace(rose::filesystem::obtain_xdg_path(
+                    "XDG_STATE_HOME", ".local/state", "dispatcher-trace.json"));
+            }
+
+            return true;
+        });
+    }
 
     // Initialize execution flag.
     auto is_prompt_privileged = false;
 
-    // Run event loop.
+    // Define a function which waits for the next SDL event.
+    // Note: In integrated mode IPC client's events are processed in this
+    // thread while waiting. When the window is hidden, the thread blocks on
+    // IPC client's file descriptors, and SDL events are checked after each
+    // wakeup, or periodically; when the window is visible, the thread blocks
+    // on SDL events, and IPC client's events are checked periodically. Events
+    // which are produced by IPC client are SDL events, so they are received
+    // right after the wakeup.
+    auto wait_event = [&](SDL_Event& event) -> bool {
+        using namespace std::chrono_literals;
+
+        // Note: The timeout of the visible window bounds the latency of IPC
+        // while the prompt is shown (IPC is rarely needed at that time), and
+        // the timeout of the hidden window bounds the latency of SDL's own
+        // events (such as window's events, or a request to quit).
+        static constexpr auto timeout_visible = 50ms, timeout_hidden = 250ms;
+
+        if(ipc_client_mode == rose::ipc_client_mode::threaded) {
+            return (SDL_WaitEvent(&event) != 0);
+        }
+
+        while(state.is_program_running) {
+            if(SDL_PollEvent(&event) != 0) {
+                return true;
+            }
+
+            if(is_window_visible) {
+                if(rose::poll(ipc_client);
+                   SDL_WaitEventTimeout(
+                       &event, static_cast<int>(timeout_visible.count()))) {
+                    return true;
+                }
+            } else {
+                rose::run_for(ipc_client, timeout_hidden);
+            }
+        }
+
+        return false;
+    };
+
+    // Define a function which checks if the given output state belongs to
+    // the display with the given index.
+    // Note: If the name or the bounds of the display can not be obtained, then
+    // they are considered empty, as in the state which is created for it.
+    auto is_output_of_display = [](struct output_state const& x, int i) {
+        auto name = SDL_GetDisplayName(i);
+        auto bounds = SDL_Rect{};
+        SDL_GetDisplayBounds(i, &bounds);
+
+        return (x.display_name == ((name != nullptr) ? name : "")) &&
+               (x.display_bounds.x == bounds.x) &&
+               (x.display_bounds.y == bounds.y) &&
+               (x.display_bounds.w == bounds.w) &&
+               (x.display_bounds.h == bounds.h);
+    };
+
+    // Define a function which obtains the state of the output which displays
+    // the window at the given DPI, and creates it, if needed.
+    // Note: The obtained state becomes the most recently used one.
+    auto obtain_output = [&](int dpi) -> struct output_state& {
+        auto display_idx = SDL_GetWindowDisplayIndex(window.get());
+        if(auto i = std::ranges::find_if(
+               outputs,
+               [&](auto const& x) {
+                   return (x.dpi == dpi) &&
+                          is_output_of_display(x, display_idx);
+               });
+           i != outputs.end()) {
+            std::rotate(i, i + 1, outputs.end());
+            return outputs.back();
+        }
+
+        if(outputs.size() == n_outputs_max) {
+            outputs.erase(outputs.begin());
+        }
+
+        auto& x = outputs.emplace_back(output_state{.dpi = dpi});
+        if(auto name = SDL_GetDisplayName(display_idx); name != nullptr) {
+            x.display_name = name;
+        }
+
+        SDL_GetDisplayBounds(display_idx, &(x.display_bounds));
+        return x;
+    };
+
+    // Define a function which updates glyph atlas texture, if the atlas has
+    // changed. Returns false if the texture can not be created.
+    // Note: Only the rows of the atlas which have been modified since the last
+    // update are uploaded, unless the texture has been created again.
+    auto update_atlas_texture = [&]() -> bool {
+        auto x = rose::describe_glyph_atlas(text_rendering_context);
+        if((x.revision == atlas.revision) || (x.h <= 0)) {
+            return true;
+        }
+
+        // Create a texture, if needed.
+        // Note: Texture's height is snapped to the size bucket, so that the
+        // texture is not created again each time the atlas grows.
+        auto revision = atlas.revision;
+        if(!(atlas.handle) || (atlas.w != x.w) || (atlas.h < x.h)) {
+            auto texture_h =
+                std::max(x.h, std::min(rose::snap_texture_size(x.h),
+                                       atlas.h_max));
+
+            atlas.handle.reset(
+                SDL_CreateTexture(renderer.get(), SDL_PIXELFORMAT_RGBA8888,
+                                  SDL_TEXTUREACCESS_STATIC, x.w, texture_h));
+
+            if(!(atlas.handle)) {
+                return false;
+            }
+
+            atlas.w = x.w;
+            atlas.h = texture_h;
+            atlas.pixels.resize(static_cast<size_t>(x.w) * texture_h * 4);
+
+            // The whole atlas must be uploaded.
+            revision = 0;
+        }
+
+        // Upload the modified rows.
+        if(auto rows = rose::render_glyph_atlas(
+               text_rendering_context,
+               {.pixels = atlas.pixels.data(), .w = atlas.w, .h = atlas.h},
+               revision);
+           rows.h > 0) {
+            auto rect =
+                SDL_Rect{.x = 0, .y = rows.y, .w = atlas.w, .h = rows.h};
+            SDL_UpdateTexture(
+                atlas.handle.get(), &rect,
+                atlas.pixels.data() + static_cast<size_t>(rows.y) * atlas.w * 4,
+                atlas.w * 4);
+        }
+
+        atlas.revision = x.revision;
+        return true;
+    };
+
+    // Define a function which prepares the frame of the given prompt with the
+    // given input on the output which displays the window: composes the text,
+    // and renders it (or lays it out), if it has changed. Returns a pointer to
+    // the frame, or nullptr if the frame can not be prepared.
     auto string = std::u8string{};
+    auto prepare_frame = [&](bool is_privileged, std::u8string_view input)
+        -> struct prompt_frame* {
+        // Obtain window size.
+        auto w = 0, h = 0, window_w = 0, window_h = 0, pitch = 0;
+        SDL_GetRendererOutputSize(renderer.get(), &w, &h);
+        SDL_GetWindowSize(window.get(), &window_w, &window_h);
+
+        // Make sure the size is correct.
+        if((w <= 0) || (h <= 0) || (window_w <= 0) || (window_h <= 0)) {
+            return nullptr;
+        }
+
+        // Compute effective DPI, and obtain the output and the frame.
+        auto dpi = static_cast<int>((96.0 * w) / window_w);
+        auto& output = obtain_output(dpi);
+        auto& frame = output.frames[is_privileged ? 1 : 0];
+
+        // Add printable ASCII characters to the glyph atlas, if needed, so
+        // that typing does not require rendering new glyphs.
+        // Note: The characters are laid out in a line which is wide enough to
+        // fit all of them.
+        if(output.atlas_font_size != theme.font_size) {
+            std::u32string characters(0x7F - 0x20, U'\0');
+            for(auto i = size_t{}; i != characters.size(); ++i) {
+                characters[i] = static_cast<char32_t>(0x20 + i);
+            }
+
+            rose::layout(text_rendering_context,
+                         {.font_size = theme.font_size,
+                          .dpi = dpi,
+                          .text_line = characters},
+                         64 * 1024, h);
+
+            output.atlas_font_size = theme.font_size;
+        }
+
+        // Compose the text which will be rendered.
+        if(string = (is_privileged ? u8"# " : u8"$ "); true) {
+            auto t = rose::trace_clock::now();
+            database.lookup_suggestions(input, string);
+
+            rose::trace(rose::trace_event::database_lookup, t,
+                        rose::trace_clock::now() - t);
+        }
+
+        // Check if the frame has changed.
+        // Note: In accelerated rendering mode, glyph quads of the frame refer
+        // to the glyph atlas, and the frame must be laid out again if the atlas
+        // has changed.
+        auto& description = frame.description;
+        auto is_frame_changed =
+            ((description.text != string) ||
+             (description.font_size != theme.font_size) ||
+             (description.dpi != dpi) || (description.w != w) ||
+             (description.h != h) ||
+             (is_rendering_accelerated &&
+              (description.atlas_revision !=
+               rose::describe_glyph_atlas(text_rendering_context).revision)));
+
+        // Note: The fields are assigned in place, so that the storage of the
+        // text is reused.
+        if(is_frame_changed) {
+            description.text.assign(string);
+            description.font_size = theme.font_size;
+            description.dpi = dpi;
+            description.w = w;
+            description.h = h;
+            description.atlas_revision = 0;
+
+            rose::convert_utf8_to_utf32(string, text_line);
+        }
+
+        // Lay the text out, if needed.
+        auto t_rendering = rose::trace_clock::now();
+        auto text_layout = rose::text_layout_result{};
+        if(is_rendering_accelerated && is_frame_changed) {
+            text_layout = rose::layout(
+                text_rendering_context,
+                {.font_size = theme.font_size,
+                 .dpi = dpi,
+                 .text_line = text_line},
+                w, h);
+
+            // Update glyph atlas texture. If the texture can not be created,
+            // then fall back to software rendering mode.
+            // Note: Other frames must be rendered again in this mode.
+            if(!update_atlas_texture()) {
+                is_rendering_accelerated = false;
+                for(auto& x : outputs) {
+                    for(auto& y : x.frames) {
+                        if(&y != &frame) {
+                            y.description = {};
+                        }
+                    }
+                }
+            }
+        }
+
+        // Render the text.
+        if(is_rendering_accelerated && is_frame_changed) {
+            description.atlas_revision =
+                rose::describe_glyph_atlas(text_rendering_context).revision;
+
+            // Compute vertices and indices of glyph quads.
+            frame.vertices.clear();
+            frame.indices.clear();
+
+            for(auto color = SDL_Color{
+                    theme.color_scheme.panel_foreground.rgba[0],
+                    theme.color_scheme.panel_foreground.rgba[1],
+                    theme.color_scheme.panel_foreground.rgba[2], 255};
+                auto const& [dst, src] : text_layout.quads) {
+                // Note: Texture coordinates are normalized.
+                auto u0 = static_cast<float>(src.x) / atlas.w,
+                     u1 = static_cast<float>(src.x + src.w) / atlas.w,
+                     v0 = static_cast<float>(src.y) / atlas.h,
+                     v1 = static_cast<float>(src.y + src.h) / atlas.h;
+
+                auto x0 = static_cast<float>(dst.x),
+                     x1 = static_cast<float>(dst.x + dst.w),
+                     y0 = static_cast<float>(dst.y),
+                     y1 = static_cast<float>(dst.y + dst.h);
+
+                auto i = static_cast<int>(frame.vertices.size());
+                frame.vertices.insert(frame.vertices.end(),
+                                      {{{x0, y0}, color, {u0, v0}},
+                                       {{x1, y0}, color, {u1, v0}},
+                                       {{x1, y1}, color, {u1, v1}},
+                                       {{x0, y1}, color, {u0, v1}}});
+
+                frame.indices.insert(frame.indices.end(),
+                                     {i, i + 1, i + 2, i, i + 2, i + 3});
+            }
+        } else if(!is_rendering_accelerated) {
+            // Create a texture, if needed.
+            // Note: Texture's size is snapped to the size bucket.
+            auto& texture = frame.texture;
+            auto damage = SDL_Rect{};
+            if(auto texture_w = rose::snap_texture_size(w),
+               texture_h = rose::snap_texture_size(h);
+               !(texture.handle) || (texture.w != texture_w) ||
+               (texture.h != texture_h)) {
+                texture.handle.reset(SDL_CreateTexture(
+                    renderer.get(), SDL_PIXELFORMAT_RGBA8888,
+                    SDL_TEXTUREACCESS_STREAMING, texture_w, texture_h));
+
+                texture.w = texture_w;
+                texture.h = texture_h;
+
+                // Clear texture's pixels.
+                texture.pixels.assign(
+                    static_cast<size_t>(texture_w) * texture_h * 4, 0);
+                texture.text_rect = {};
+
+                // The whole texture must be updated.
+                damage = {.x = 0, .y = 0, .w = texture_w, .h = texture_h};
+            }
+
+            // Render the text, if it has changed.
+            if(texture.handle &&
+               (is_frame_changed || !SDL_RectEmpty(&damage))) {
+                // Clear the region occupied by previously rendered text.
+                if(auto const& r = texture.text_rect; true) {
+                    for(auto j = r.y; j < (r.y + r.h); ++j) {
+                        std::fill_n(texture.pixels.data() +
+                                        (j * texture.w + r.x) * 4,
+                                    r.w * 4, 0);
+                    }
+                }
+
+                // Render the text.
+                auto result = rose::render(
+                    text_rendering_context,
+                    {.font_size = theme.font_size,
+                     .dpi = dpi,
+                     .text_line = text_line},
+                    {.pixels = texture.pixels.data(),
+                     .w = w,
+                     .h = h,
+                     .pitch = texture.w * 4});
+
+                // Compute the damaged region.
+                auto text_rect =
+                    SDL_Rect{.x = static_cast<int>(result.rectangle.x),
+                             .y = static_cast<int>(result.rectangle.y),
+                             .w = static_cast<int>(result.rectangle.w),
+                             .h = static_cast<int>(result.rectangle.h)};
+
+                // Note: If the texture has just been created, then it is
+                // damaged entirely.
+                if(SDL_RectEmpty(&damage)) {
+                    SDL_UnionRect(&(texture.text_rect), &text_rect, &damage);
+                }
+
+                // Save the region occupied by rendered text.
+                texture.text_rect = text_rect;
+            }
+
+            // Update the damaged region of the texture.
+            for(void* buffer = nullptr;
+                texture.handle && !SDL_RectEmpty(&damage);) {
+                // Lock the region.
+                SDL_LockTexture(texture.handle.get(), &damage, &buffer, &pitch);
+                if(buffer == nullptr) {
+                    break;
+                }
+
+                // Copy the pixels.
+                for(auto j = 0; j != damage.h; ++j) {
+                    std::copy_n(texture.pixels.data() +
+                                    ((damage.y + j) * texture.w + damage.x) * 4,
+                                damage.w * 4,
+                                static_cast<unsigned char*>(buffer) +
+                                    j * pitch);
+                }
+
+                // Unlock the texture.
+                SDL_UnlockTexture(texture.handle.get());
+                break;
+            }
+        }
+
+        if(is_frame_changed) {
+            rose::trace(rose::trace_event::text_rendering, t_rendering,
+                        rose::trace_clock::now() - t_rendering);
+        }
+
+        return &frame;
+    };
+
+    // Define a function which presents the given prepared frame.
+    auto present_frame = [&](struct prompt_frame const& frame) {
+        // Set background color.
+        SDL_SetRenderDrawColor(renderer.get(), //
+                               theme.color_scheme.panel_background.rgba[0],
+                               theme.color_scheme.panel_background.rgba[1],
+                               theme.color_scheme.panel_background.rgba[2],
+                               theme.color_scheme.panel_background.rgba[3]);
+
+        // Clear color.
+        SDL_RenderClear(renderer.get());
+
+        // Render the text.
+        if(is_rendering_accelerated) {
+            if(atlas.handle && !(frame.indices.empty())) {
+                SDL_SetTextureBlendMode(atlas.handle.get(), SDL_BLENDMODE_ADD);
+
+                SDL_RenderGeometry(
+                    renderer.get(), atlas.handle.get(), frame.vertices.data(),
+                    static_cast<int>(frame.vertices.size()),
+                    frame.indices.data(),
+                    static_cast<int>(frame.indices.size()));
+            }
+        } else if(auto const& texture = frame.texture; texture.handle) {
+            SDL_SetTextureBlendMode(texture.handle.get(), SDL_BLENDMODE_ADD);
+
+            SDL_SetTextureColorMod( //
+                texture.handle.get(),
+                theme.color_scheme.panel_foreground.rgba[0],
+                theme.color_scheme.panel_foreground.rgba[1],
+                theme.color_scheme.panel_foreground.rgba[2]);
+
+            // Note: Only the region of the texture which is occupied by the
+            // frame is copied.
+            auto src = SDL_Rect{.x = 0,
+                                .y = 0,
+                                .w = frame.description.w,
+                                .h = frame.description.h};
+
+            SDL_RenderCopy(
+                renderer.get(), texture.handle.get(), &src, nullptr);
+        }
+
+        // Swap buffers.
+        SDL_RenderPresent(renderer.get());
+        rose::trace(rose::trace_event::present);
+    };
+
+    // Run event loop.
     for(SDL_StartTextInput(); state.is_program_running;) {
+        // While the window is hidden, keep the frames of both prompts rendered
+        // with empty input (warm standby).
+        // Note: Texture of each frame (or glyph quads, in accelerated rendering
+        // mode) remains valid until the next change of the frame.
+        if(!is_window_visible && is_standby_outdated) {
+            prepare_frame(false, {});
+            prepare_frame(true, {});
+            is_standby_outdated = false;
+        }
+
         // Process events.
-        if(SDL_Event event; SDL_WaitEvent(&event) != 0) {
+        if(SDL_Event event; wait_event(event)) {
             if(event.type == state.event_idx) {
-                // Process IPC request.
-                switch(static_cast<rose::request>(event.user.code)) {
-                    case rose::request::prompt_normal:
-                        show_window(), text_input.clear();
-                        is_prompt_privileged = false;
-                        break;
+                // Process IPC requests.
+                // Note: Each event delivers a set of requests.
+                rose::trace(rose::trace_event::request);
+                auto requests = static_cast<rose::request_set>(event.user.code);
+
+                // Record the launches which have been reported as successful.
+                // Note: Reports arrive in the order of the commands.
+                if(requests &
+                   (rose::to_request_set(rose::request::report_launch_failure) |
+                    rose::to_request_set(
+                        rose::request::report_launch_success))) {
+                    auto lock = std::lock_guard{launch_reports.mutex};
+                    for(auto const& report : launch_reports.list) {
+                        while(!(pending_launches.empty()) &&
+                              (pending_launches.front().id <= report.id)) {
+                            if((pending_launches.front().id == report.id) &&
+                               (report.error == 0)) {
+                                database.record_launch(
+                                    pending_launches.front().command_string);
+                            }
+
+                            pending_launches.pop_front();
+                        }
+                    }
 
-                    case rose::request::prompt_privileged:
-                        show_window(), text_input.clear();
-                        is_prompt_privileged = true;
-                        break;
+                    launch_reports.list.clear();
+                }
 
-                    case rose::request::reload_database:
-                        database.initialize();
-                        break;
+                for(auto x : {rose::request::prompt_normal,
+                              rose::request::prompt_privileged,
+                              rose::request::reload_database,
+                              rose::request::reload_theme,
+                              rose::request::update_outputs}) {
+                    if((requests & rose::to_request_set(x)) == 0) {
+                        continue;
+                    }
+
+                    switch(x) {
+                        case rose::request::prompt_normal:
+                            show_window(), text_input.clear();
+                            is_prompt_privileged = false;
+                            break;
+
+                        case rose::request::prompt_privileged:
+                            show_window(), text_input.clear();
+                            is_prompt_privileged = true;
+                            break;
+
+                        case rose::request::reload_database:
+                            database.reload();
+                            break;
+
+                        case rose::request::reload_theme:
+                            // Note: If the theme has not changed, then the
+                            // frames are kept. Otherwise, the frames which
+                            // have been rendered with a different font size
+                            // are detected by their descriptions, and glyphs
+                            // and layouts for other font sizes remain cached.
+                            // Colors are applied upon presentation, except for
+                            // glyph quads in accelerated rendering mode.
+                            if(!rose::reload_theme(theme)) {
+                                break;
+                            }
 
-                    case rose::request::reload_theme:
-                        theme = rose::initialize_theme();
-                        break;
+                            if(is_rendering_accelerated) {
+                                for(auto& output : outputs) {
+                                    for(auto& frame : output.frames) {
+                                        frame.description = {};
+                                    }
+                                }
+                            }
+
+                            is_window_updated = is_standby_outdated = true;
+                            break;
+
+                        case rose::request::update_outputs:
+                            // Destroy the states of the displays which no
+                            // longer exist.
+                            // Note: The states of other displays are kept,
+                            // with their frames.
+                            std::erase_if(outputs, [&](auto const& x) {
+                                for(auto i = 0, n = SDL_GetNumVideoDisplays();
+                                    i < n; ++i) {
+                                    if(is_output_of_display(x, i)) {
+                                        return false;
+                                    }
+                                }
 
-                    default:
-                        break;
+                                return true;
+                            });
+
+                            is_window_updated = is_standby_outdated = true;
+                            break;
+
+                        default:
+                            break;
+                    }
                 }
             } else {
                 switch(event.type) {
@@ -239,7 +1052,7 @@ main() {
                                 break;
 
                             case SDL_WINDOWEVENT_SIZE_CHANGED:
-                                is_window_updated = true;
+                                is_window_updated = is_standby_outdated = true;
                                 break;
 
                             default:
@@ -249,6 +1062,7 @@ main() {
                         break;
 
                     case SDL_KEYDOWN:
+                        rose::trace(rose::trace_event::input);
                         switch(event.key.keysym.sym) {
                             case SDLK_ESCAPE:
                                 hide_window();
@@ -267,10 +1081,25 @@ main() {
                                 database.modify_command_string(
                                     text_input, string);
 
+                                // Note: Privileged commands are executed by
+                                // the compositor, which does not report
+                                // their launches, so they are recorded once
+                                // they have been sent.
                                 if(is_prompt_privileged) {
-                                    rose::execute(ipc_client, string);
-                                } else {
-                                    rose::execute(pipe, string);
+                                    if(rose::execute(ipc_client, string) ==
+                                       rose::execution_result::success) {
+                                        database.record_launch(string);
+                                    }
+                                } else if(rose::execute(pipe, string) ==
+                                          rose::execution_result::success) {
+                                    if(pipe.report_fd() == -1) {
+                                        database.record_launch(string);
+                                    } else {
+                                        pending_launches.push_back(
+                                            {launch_id, string});
+                                    }
+
+                                    ++launch_id;
                                 }
 
                                 hide_window();
@@ -284,6 +1113,7 @@ main() {
                         break;
 
                     case SDL_TEXTINPUT:
+                        rose::trace(rose::trace_event::input);
                         text_input.enter(
                             reinterpret_cast<char8_t*>(event.text.text));
 
@@ -302,92 +1132,13 @@ main() {
         }
 
         // Render a frame, if needed.
-        auto w = 0, h = 0, window_w = 0, window_h = 0, pitch = 0;
         for(; is_window_updated; is_window_updated = false) {
-            // Obtain window size.
-            SDL_GetRendererOutputSize(renderer.get(), &w, &h);
-            SDL_GetWindowSize(window.get(), &window_w, &window_h);
-
-            // Make sure the size is correct.
-            if((w <= 0) || (h <= 0) || (window_w <= 0) || (window_h <= 0)) {
-                break;
-            }
-
-            // Compute effective DPI.
-            auto dpi = static_cast<int>((96.0 * w) / window_w);
-
-            // Create a texture, if needed.
-            if(!(texture.handle) || (texture.w != w) || (texture.h != h)) {
-                texture.handle.reset(
-                    SDL_CreateTexture(renderer.get(), SDL_PIXELFORMAT_RGBA8888,
-                                      SDL_TEXTUREACCESS_STREAMING, w, h));
-
-                texture.w = w;
-                texture.h = h;
-            }
-
-            // Render text.
-            for(void* buffer = nullptr; texture.handle;) {
-                // Lock the texture.
-                SDL_LockTexture(texture.handle.get(), nullptr, &buffer, &pitch);
-                if(buffer == nullptr) {
-                    break;
-                }
-
-                // Initialize render target description.
-                auto render_target = rose::render_target{
-                    .pixels = static_cast<unsigned char*>(buffer),
-                    .w = w,
-                    .h = h,
-                    .pitch = pitch};
-
-                // Clear the texture.
-                std::fill_n(render_target.pixels, h * pitch, 0);
-
-                // Compose the text which will be rendered to the texture.
-                if(string = (is_prompt_privileged ? u8"# " : u8"$ "); true) {
-                    database.lookup_suggestions(text_input, string);
-                }
-
-                // Render the text.
-                render(text_rendering_context,
-                       {.font_size = theme.font_size,
-                        .dpi = dpi,
-                        .text_line = rose::convert_utf8_to_utf32(string)},
-                       render_target);
-
-                // Unlock the texture.
-                SDL_UnlockTexture(texture.handle.get());
+            auto frame = prepare_frame(is_prompt_privileged, text_input);
+            if(frame == nullptr) {
                 break;
             }
 
-            // Set background color.
-            SDL_SetRenderDrawColor(renderer.get(), //
-                                   theme.color_scheme.panel_background.rgba[0],
-                                   theme.color_scheme.panel_background.rgba[1],
-                                   theme.color_scheme.panel_background.rgba[2],
-                                   theme.color_scheme.panel_background.rgba[3]);
-
-            // Clear color.
-            SDL_RenderClear(renderer.get());
-
-            // Render the text.
-            if(texture.handle) {
-                SDL_SetTextureBlendMode(
-                    texture.handle.get(), SDL_BLENDMODE_ADD);
-
-                SDL_SetTextureColorMod( //
-                    texture.handle.get(),
-                    theme.color_scheme.panel_foreground.rgba[0],
-                    theme.color_scheme.panel_foreground.rgba[1],
-                    theme.color_scheme.panel_foreground.rgba[2]);
-
-                SDL_RenderCopy(
-                    renderer.get(), texture.handle.get(), nullptr, nullptr);
-            }
-
-            // Swap buffers.
-            SDL_RenderPresent(renderer.get());
+            present_frame(*frame);
         }
     }
 
@@ -5,11 +5,29 @@
 //
 #include "rendering_text.hh"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include <ft2build.h>
 #include FT_FREETYPE_H
-#include FT_GLYPH_H
+#include FT_SIZES_H
+
+#include <fribidi/fribidi.h>
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <ranges>
+#include <string>
+#include <unordered_map>
 #include <utility>
 
 namespace rose {
@@ -24,35 +42,22 @@ struct freetype_font_face {
     ////////////////////////////////////////////////////////////////////////////
 
     freetype_font_face(FT_Library ft, std::vector<unsigned char> font_data)
-        : face{}, data{std::move(font_data)} {
-        // Create a new font face.
-        if(FT_New_Memory_Face( //
-               ft, this->data.data(), this->data.size(), 0, &(this->face)) !=
-           FT_Err_Ok) {
-            goto error;
-        }
-
-        // Make sure it represents a scalable font.
-        if(!FT_IS_SCALABLE(this->face)) {
-            goto error;
-        }
-
-        // Initialization succeeded.
-        return;
-
-    error:
-        // On error, free memory.
-        if(this->face != nullptr) {
-            FT_Done_Face(this->face);
-        }
+        : face{}, data{std::move(font_data)}, file{}, sizes{}, active_size{} {
+        this->open_(ft, this->data);
+    }
 
-        this->face = nullptr;
+    freetype_font_face(FT_Library ft, filesystem::file_mapping font_file)
+        : face{}, data{}, file{std::move(font_file)}, sizes{}, active_size{} {
+        this->open_(ft, this->file.data());
     }
 
     freetype_font_face(freetype_font_face const&) = delete;
     freetype_font_face(freetype_font_face&& other)
         : face{std::exchange(other.face, nullptr)}
-        , data{std::move(other.data)} {
+        , data{std::move(other.data)}
+        , file{std::move(other.file)}
+        , sizes{std::move(other.sizes)}
+        , active_size{std::exchange(other.active_size, nullptr)} {
     }
 
     ~freetype_font_face() {
@@ -69,10 +74,65 @@ struct freetype_font_face {
     operator=(freetype_font_face other) noexcept -> freetype_font_face& {
         std::swap(this->face, other.face);
         std::swap(this->data, other.data);
+        std::swap(this->file, other.file);
+        std::swap(this->sizes, other.sizes);
+        std::swap(this->active_size, other.active_size);
 
         return *this;
     }
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Size selection interface.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Activates the size object for the given font size and DPI. Creates the
+    // size object, if needed. Returns true on success.
+    auto
+    select_size(int font_size, int dpi) -> bool {
+        // Check if the size is already active.
+        if((this->active_size != nullptr) &&
+           (this->active_size->font_size == font_size) &&
+           (this->active_size->dpi == dpi)) {
+            return true;
+        }
+
+        // Find a size object which has been created earlier.
+        auto i = std::ranges::find_if(this->sizes, [&](auto const& x) {
+            return (x.font_size == font_size) && (x.dpi == dpi);
+        });
+
+        // Deactivate current size object.
+        this->active_size = nullptr;
+
+        // If there is no such object, then create a new one.
+        if(i == this->sizes.end()) {
+            auto handle = FT_Size{};
+            if(FT_New_Size(this->face, &handle) != FT_Err_Ok) {
+                return false;
+            }
+
+            if((FT_Activate_Size(handle) != FT_Err_Ok) ||
+               (FT_Set_Char_Size(this->face, 0, font_size * 64, dpi, dpi) !=
+                FT_Err_Ok)) {
+                FT_Done_Size(handle);
+                return false;
+            }
+
+            this->active_size = &(this->sizes.emplace_back(
+                size{.font_size = font_size, .dpi = dpi, .handle = handle}));
+
+            return true;
+        }
+
+        // Otherwise, activate existing size object.
+        if(FT_Activate_Size(i->handle) != FT_Err_Ok) {
+            return false;
+        }
+
+        this->active_size = &(*i);
+        return true;
+    }
+
     ////////////////////////////////////////////////////////////////////////////
     // Conversion operator.
     ////////////////////////////////////////////////////////////////////////////
@@ -86,7 +146,271 @@ struct freetype_font_face {
     ////////////////////////////////////////////////////////////////////////////
 
     FT_Face face;
+
+    // Font data: either owned by the face, or mapped from a file.
     std::vector<unsigned char> data;
+    filesystem::file_mapping file;
+
+    // Size objects created for each requested pair of font size and DPI.
+    // Note: Size objects are destroyed together with the face.
+    struct size {
+        int font_size, dpi;
+        FT_Size handle;
+    };
+
+    std::deque<size> sizes;
+    size const* active_size;
+
+private:
+    ////////////////////////////////////////////////////////////////////////////
+    // Initialization utility function.
+    ////////////////////////////////////////////////////////////////////////////
+
+    void
+    open_(FT_Library ft, std::span<unsigned char const> font_data) {
+        // Create a new font face.
+        if(FT_New_Memory_Face(ft, font_data.data(),
+                              static_cast<FT_Long>(font_data.size()), 0,
+                              &(this->face)) != FT_Err_Ok) {
+            goto error;
+        }
+
+        // Make sure it represents a scalable font.
+        if(!FT_IS_SCALABLE(this->face)) {
+            goto error;
+        }
+
+        // Initialization succeeded.
+        return;
+
+    error:
+        // On error, free memory.
+        if(this->face != nullptr) {
+            FT_Done_Face(this->face);
+        }
+
+        this->face = nullptr;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Glyph atlas. Stores coverage bitmaps of rendered glyphs in a single 8-bit
+// image which is packed into shelves (rows of glyphs of similar height). The
+// atlas has fixed width and grows downwards, up to its maximum height.
+////////////////////////////////////////////////////////////////////////////////
+
+struct glyph_atlas {
+    ////////////////////////////////////////////////////////////////////////////
+    // Atlas width, and default maximum height.
+    ////////////////////////////////////////////////////////////////////////////
+
+    static constexpr auto w = 1024, h_max_default = 4096;
+
+    // Note: Offset which is returned when a region can not be allocated.
+    static constexpr auto npos = std::numeric_limits<size_t>::max();
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Shelf type.
+    ////////////////////////////////////////////////////////////////////////////
+
+    struct shelf {
+        // Vertical offset, height, and the offset of the free space.
+        int y, h, x;
+    };
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Allocation interface.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Allocates a region of the given size, returns the offset of its top-left
+    // corner in the pixel buffer, or npos if the atlas is full.
+    // Note: Region's width must not exceed atlas width.
+    auto
+    allocate(int region_w, int region_h) -> size_t {
+        // Find the shortest shelf which can fit the region without wasting too
+        // much space.
+        auto target = static_cast<shelf*>(nullptr);
+        for(auto& x : this->shelves) {
+            if((x.h >= region_h) && (x.h <= (region_h + region_h / 4 + 1)) &&
+               ((w - x.x) >= region_w) &&
+               ((target == nullptr) || (x.h < target->h))) {
+                target = &x;
+            }
+        }
+
+        // If there is no such shelf, then add a new one, if possible.
+        if(target == nullptr) {
+            if(region_h > (this->h_max - this->h)) {
+                // Note: If a region does not fit into an empty atlas, then
+                // clearing the atlas does not help.
+                this->is_full = (this->h > 0);
+                return npos;
+            }
+
+            target = &(this->shelves.emplace_back(
+                shelf{.y = this->h, .h = region_h, .x = 0}));
+
+            this->h += region_h;
+            this->pixels.resize(static_cast<size_t>(this->h) * w);
+            this->row_revisions.resize(static_cast<size_t>(this->h));
+        }
+
+        // Allocate the region.
+        auto offset = static_cast<size_t>(target->y) * w + target->x;
+        target->x += region_w;
+
+        // Note: The caller fills the region, which modifies the atlas.
+        this->revision++;
+        std::fill_n(this->row_revisions.begin() + target->y, region_h,
+                    this->revision);
+
+        return offset;
+    }
+
+    // Frees all allocated regions.
+    void
+    clear() noexcept {
+        this->shelves.clear();
+        this->pixels.clear();
+        this->row_revisions.clear();
+        this->h = 0;
+        this->is_full = false;
+        this->revision++;
+        this->generation++;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Data members.
+    ////////////////////////////////////////////////////////////////////////////
+
+    std::vector<shelf> shelves;
+    std::vector<unsigned char> pixels;
+    int h, h_max = h_max_default;
+
+    // Flag that shows whether a region could not be allocated since the atlas
+    // has been cleared.
+    bool is_full;
+
+    // Revision number, incremented on each modification, and generation
+    // number, incremented each time the atlas is cleared.
+    unsigned long long revision, generation;
+
+    // Revision number of the last modification of each row of pixels.
+    std::vector<unsigned long long> row_revisions;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Glyph cache. Maps characters to glyphs rendered at specific font size and
+// DPI.
+////////////////////////////////////////////////////////////////////////////////
+
+struct glyph_key {
+    char32_t c;
+    int font_size, dpi;
+
+    auto
+    operator==(glyph_key const&) const -> bool = default;
+};
+
+struct glyph_key_hash {
+    auto
+    operator()(glyph_key const& key) const noexcept -> size_t {
+        return std::hash<std::uint64_t>{}(
+            (static_cast<std::uint64_t>(key.c) << 40) ^
+            (static_cast<std::uint64_t>(key.font_size) << 20) ^
+            static_cast<std::uint64_t>(key.dpi));
+    }
+};
+
+struct cached_glyph {
+    // Bounding box of glyph's bitmap relative to the pen position.
+    FT_BBox bbox;
+
+    // Horizontal advance.
+    FT_Pos advance_x;
+
+    // Size of glyph's bitmap, and its offset in the atlas.
+    int w, h;
+    size_t atlas_offset;
+
+    // Index of the font face which contains the glyph.
+    size_t font_face_index;
+
+    // Flag that shows whether the glyph has been rendered successfully.
+    bool is_valid;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Layout cache. Stores glyph quads of recently laid out text lines.
+////////////////////////////////////////////////////////////////////////////////
+
+struct cached_layout {
+    // Text line (in logical order) and layout parameters.
+    std::u32string text_line;
+    int font_size, dpi, w, h;
+
+    // Generation of the atlas which contains the glyphs.
+    unsigned long long atlas_generation;
+
+    // Glyph quads and the number of consumed code points.
+    std::vector<glyph_quad> quads;
+    size_t n_code_points_consumed;
+
+    // Time of the last use.
+    unsigned long long time;
+};
+
+// Note: Maximum number of cached layouts. When the cache is full, the least
+// recently used layout is replaced.
+static constexpr auto n_cached_layouts_max = size_t{16};
+
+// Note: Initial capacity of a cached layout: the number of code points in its
+// text line, and the number of its quads.
+static constexpr auto cached_layout_n_code_points = size_t{512};
+static constexpr auto cached_layout_n_quads = size_t{256};
+
+////////////////////////////////////////////////////////////////////////////////
+// Rendered text line. Its storage is owned by the context, and is reused
+// between rendering calls.
+////////////////////////////////////////////////////////////////////////////////
+
+struct rendered_glyph {
+    // Cached glyph.
+    cached_glyph const* glyph;
+
+    // Pen position.
+    FT_Pos pen_x;
+};
+
+struct rendered_text_line {
+    // Rendered glyphs.
+    std::vector<rendered_glyph> glyphs;
+
+    // Rendering history (used for backtracking): pen position of each glyph,
+    // and text line's bounding box after the glyph has been added.
+    struct history_entry {
+        FT_Pos pen_x;
+        FT_BBox bbox;
+    };
+
+    std::vector<history_entry> history;
+
+    // Bounding box and reference space of the text line.
+    FT_BBox bbox;
+    FT_Pos y_ref_min, y_ref_max;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Shaped text line. Its storage is owned by the context, and is reused between
+// shaping calls.
+////////////////////////////////////////////////////////////////////////////////
+
+struct shaped_text_line {
+    // Input and output buffers of the Unicode Bidirectional Algorithm.
+    std::vector<FriBidiChar> src, dst;
+
+    // Text line in visual order.
+    std::u32string text;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -101,9 +425,19 @@ struct text_rendering_context {
     ////////////////////////////////////////////////////////////////////////////
 
     text_rendering_context(struct text_rendering_context_parameters params)
-        : ft{}, font_faces{} {
+        : ft{}
+        , font_faces{}
+        , font_files{}
+        , face_selection{}
+        , glyph_cache{}
+        , atlas{}
+        , layouts{}
+        , layout_time{}
+        , shaped_text_line{}
+        , text_line{}
+        , row_quads{} {
         // Make sure at least one font is supplied.
-        if(params.fonts.empty()) {
+        if(params.fonts.empty() && params.font_files.empty()) {
             return;
         }
 
@@ -113,7 +447,8 @@ struct text_rendering_context {
         }
 
         // Reserve memory for font faces.
-        this->font_faces.reserve(params.fonts.size());
+        this->font_faces.reserve(
+            params.fonts.size() + params.font_files.size());
 
         // Initialize font faces.
         for(auto& font : params.fonts) {
@@ -123,6 +458,21 @@ struct text_rendering_context {
             }
         }
 
+        // Save font files, they are opened on demand.
+        // Note: Files are stored in reverse order, so that the next file can
+        // be removed from the back of the list.
+        for(auto& file : params.font_files | std::views::reverse) {
+            this->font_files.push_back(std::move(file));
+        }
+
+        // Make sure at least one font face is open.
+        if(this->font_faces.empty() && !(this->open_font_face())) {
+            goto error;
+        }
+
+        // Initialize face selection table.
+        this->face_selection.resize(face_selection_table_size);
+
         // Initialization succeeded.
         return;
 
@@ -154,12 +504,71 @@ struct text_rendering_context {
     auto
     operator=(text_rendering_context&&) = delete;
 
+    ////////////////////////////////////////////////////////////////////////////
+    // Font face opening interface.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Opens the font face of the next font file. Skips the files which can
+    // not be opened. Returns false if there are no more files.
+    auto
+    open_font_face() -> bool {
+        while(!(this->font_files.empty())) {
+            auto file = std::move(this->font_files.back());
+            this->font_files.pop_back();
+
+            if(auto x = freetype_font_face{this->ft, std::move(file)};
+               x.face != nullptr) {
+                this->font_faces.push_back(std::move(x));
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Face selection table type.
+    ////////////////////////////////////////////////////////////////////////////
+
+    // Note: The table is split into pages of consecutive code points, which
+    // are allocated on first use. Each entry of a page contains the index of
+    // the font face which has been selected for the code point.
+    static constexpr auto face_selection_page_size = size_t{256};
+    static constexpr auto face_selection_table_size =
+        size_t{0x110000} / face_selection_page_size;
+
+    // Note: Index of the face which has not been selected yet.
+    static constexpr auto face_index_unknown = std::uint8_t{0xFF};
+
+    using face_selection_page =
+        std::array<std::uint8_t, face_selection_page_size>;
+
     ////////////////////////////////////////////////////////////////////////////
     // Data members.
     ////////////////////////////////////////////////////////////////////////////
 
     FT_Library ft;
     std::vector<freetype_font_face> font_faces;
+
+    // Font files which have not been opened yet (in reverse order).
+    std::vector<filesystem::file_mapping> font_files;
+
+    // Face selection table.
+    std::vector<std::unique_ptr<face_selection_page>> face_selection;
+
+    // Rendered glyphs.
+    std::unordered_map<glyph_key, cached_glyph, glyph_key_hash> glyph_cache;
+    glyph_atlas atlas;
+
+    // Recently laid out text lines, and layout cache's clock.
+    std::vector<cached_layout> layouts;
+    unsigned long long layout_time;
+
+    // Storage for the text line which is being shaped and rendered, and for
+    // glyph quads of multiple text lines.
+    struct shaped_text_line shaped_text_line;
+    rendered_text_line text_line;
+    std::vector<glyph_quad> row_quads;
 };
 
 void
@@ -195,120 +604,245 @@ stretch_bbox(FT_BBox a, FT_BBox b, FT_Pos offset_x) -> FT_BBox {
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Glyph rendering utility function.
+// Font face selection utility function.
 ////////////////////////////////////////////////////////////////////////////////
 
+// Returns the index of the first font face which contains the given code
+// point, or zero if there is no such face. Opens new faces, if needed. The
+// result is saved in the face selection table.
 static auto
-render_glyph(text_rendering_context const& context, char32_t c)
-    -> FT_GlyphSlot {
-    // Find a font face which contains the given character's code point.
-    auto const* font_face = context->font_faces.data();
-    for(auto const& face : context->font_faces) {
-        if(FT_Get_Char_Index(face, c) != 0) {
-            font_face = &face;
+select_font_face(text_rendering_context const& context, char32_t c) -> size_t {
+    using context_type = detail::text_rendering_context;
+
+    // Look the code point up in the face selection table.
+    auto* entry = static_cast<std::uint8_t*>(nullptr);
+    if(auto k = c / context_type::face_selection_page_size;
+       k < context->face_selection.size()) {
+        auto& page = context->face_selection[k];
+        if(!page) {
+            page = std::make_unique<context_type::face_selection_page>();
+            page->fill(context_type::face_index_unknown);
+        }
+
+        entry = &((*page)[c % context_type::face_selection_page_size]);
+        if(*entry != context_type::face_index_unknown) {
+            return *entry;
+        }
+    }
+
+    // Find the first font face which contains the code point.
+    auto i = size_t{};
+    for(; true; ++i) {
+        if((i == context->font_faces.size()) && !(context->open_font_face())) {
+            i = 0;
             break;
         }
+
+        if(FT_Get_Char_Index(context->font_faces[i], c) != 0) {
+            break;
+        }
+    }
+
+    // Save the result.
+    if((entry != nullptr) && (i < context_type::face_index_unknown)) {
+        *entry = static_cast<std::uint8_t>(i);
+    }
+
+    return i;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Glyph rendering utility function.
+////////////////////////////////////////////////////////////////////////////////
+
+static auto
+render_glyph(text_rendering_context const& context, glyph_key key)
+    -> std::pair<FT_GlyphSlot, size_t> {
+    // Select a font face which contains the given character's code point.
+    auto i = select_font_face(context, key.c);
+    auto* font_face = &(context->font_faces[i]);
+
+    // Select font size.
+    if(!(font_face->select_size(key.font_size, key.dpi))) {
+        return {nullptr, i};
     }
 
     // Render a glyph for the given character.
-    if(FT_Load_Char(*font_face, c, FT_LOAD_RENDER) != FT_Err_Ok) {
-        return nullptr;
+    if(FT_Load_Char(*font_face, key.c, FT_LOAD_RENDER) != FT_Err_Ok) {
+        return {nullptr, i};
     }
 
     // Validate rendered glyph's format.
     if(font_face->face->glyph->format != FT_GLYPH_FORMAT_BITMAP) {
-        return nullptr;
+        return {nullptr, i};
     }
 
     // Return the glyph slot with rendered glyph.
-    return font_face->face->glyph;
+    return {font_face->face->glyph, i};
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Text rendering utility function and type.
+// Glyph cache lookup utility function.
 ////////////////////////////////////////////////////////////////////////////////
 
-struct rendered_text_line {
-    FT_Glyph glyphs[256];
-    size_t n_glyphs;
+static auto
+obtain_glyph(text_rendering_context const& context, glyph_key key)
+    -> cached_glyph const* {
+    // Look the glyph up in the cache.
+    auto [i, is_inserted] = context->glyph_cache.try_emplace(key);
+    if(auto& x = i->second; !is_inserted) {
+        return (x.is_valid ? &x : nullptr);
+    }
 
-    FT_BBox bbox;
-    FT_Pos y_ref_min, y_ref_max;
-};
+    // Render the glyph.
+    auto [glyph, font_face_index] = render_glyph(context, key);
+    if(glyph == nullptr) {
+        i->second = {.font_face_index = font_face_index, .is_valid = false};
+        return nullptr;
+    }
+
+    // Copy its bitmap to the atlas.
+    // Note: Glyphs which are wider than the atlas are cropped.
+    auto w = std::min(static_cast<int>(glyph->bitmap.width), glyph_atlas::w);
+    auto h = static_cast<int>(glyph->bitmap.rows);
+
+    auto atlas_offset = size_t{};
+    if((w > 0) && (h > 0)) {
+        // Note: If the atlas is full, then the glyph is not cached, so that it
+        // is rendered again after the atlas has been cleared.
+        if(atlas_offset = context->atlas.allocate(w, h);
+           atlas_offset == glyph_atlas::npos) {
+            context->glyph_cache.erase(i);
+            return nullptr;
+        }
+
+        auto bitmap_pitch =
+            ((glyph->bitmap.pitch < 0) ? -(glyph->bitmap.pitch)
+                                       : +(glyph->bitmap.pitch));
+
+        auto src = glyph->bitmap.buffer;
+        auto dst = context->atlas.pixels.data() + atlas_offset;
+        for(auto j = 0; j != h;
+            ++j, src += bitmap_pitch, dst += glyph_atlas::w) {
+            std::copy_n(src, w, dst);
+        }
+    }
+
+    // Cache the glyph.
+    i->second = {.bbox = compute_bbox(glyph),
+                 .advance_x = (glyph->advance.x / 64),
+                 .w = w,
+                 .h = h,
+                 .atlas_offset = atlas_offset,
+                 .font_face_index = font_face_index,
+                 .is_valid = true};
+
+    return &(i->second);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Text shaping utility function. Converts the given text line from logical to
+// visual order using the Unicode Bidirectional Algorithm. Arabic characters
+// are also replaced with their presentation forms (joining and ligatures).
+//
+// Note: Shaping is done only when the text line is laid out, so its results
+// are cached together with the layout.
+////////////////////////////////////////////////////////////////////////////////
 
 static auto
-render(text_rendering_context const& context, FT_Pos pen_x, FT_Pos w_max,
-       struct text_rendering_parameters params) -> struct rendered_text_line {
-    // Initialize empty result.
-    auto result = (struct rendered_text_line){};
+shape(text_rendering_context const& context, std::span<char32_t> text_line)
+    -> std::span<char32_t> {
+    // Obtain the buffers.
+    auto& [src, dst, result] = context->shaped_text_line;
+    auto const n = text_line.size();
 
     // Make sure the text line is not empty.
-    if(params.text_line.empty()) {
+    if(result.clear(); n == 0) {
         return result;
     }
 
-    // Limit the size of the text line.
-    if(std::size(params.text_line) > std::size(result.glyphs)) {
-        params.text_line = params.text_line.first(std::size(result.glyphs));
-    }
+    // Copy the text line into the input buffer.
+    src.assign(text_line.begin(), text_line.end());
+    dst.resize(n);
+
+    // Run the algorithm.
+    auto base_dir = static_cast<FriBidiParType>(FRIBIDI_TYPE_ON);
+    fribidi_log2vis(src.data(), static_cast<FriBidiStrIndex>(n), &base_dir,
+                    dst.data(), nullptr, nullptr, nullptr);
 
-    // Set font size.
-    for(auto& face : context->font_faces) {
-        FT_Set_Char_Size(
-            face, 0, params.font_size * 64, params.dpi, params.dpi);
+    // Copy algorithm's output to the resulting text line.
+    // Note: The text line is resized and overwritten, instead of being
+    // assigned from the range, so that its storage is reused.
+    result.resize(n);
+    std::ranges::copy(dst, result.begin());
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Text rendering utility function.
+////////////////////////////////////////////////////////////////////////////////
+
+static auto
+render_once(text_rendering_context const& context, FT_Pos pen_x,
+            FT_Pos w_max, struct text_rendering_parameters params)
+    -> struct rendered_text_line const& {
+    // Initialize empty result.
+    auto& result = context->text_line;
+
+    result.glyphs.clear();
+    result.history.clear();
+    result.bbox = {};
+    result.y_ref_min = result.y_ref_max = 0;
+
+    // Make sure the text line is not empty.
+    if(params.text_line.empty()) {
+        return result;
     }
 
+    // Define glyph lookup function.
+    auto lookup = [&](char32_t c) {
+        return obtain_glyph(context, {.c = c,
+                                      .font_size = params.font_size,
+                                      .dpi = params.dpi});
+    };
+
     // Compute reference space for text line.
-    if(auto glyph = render_glyph(context, 0x4D); glyph != nullptr) {
-        result.y_ref_min = glyph->bitmap_top - glyph->bitmap.rows;
-        result.y_ref_max = glyph->bitmap_top;
+    if(auto glyph = lookup(0x4D); glyph != nullptr) {
+        result.y_ref_min = glyph->bbox.yMin;
+        result.y_ref_max = glyph->bbox.yMax;
     }
 
     // Initialize bounding box for text line.
     result.bbox =
         FT_BBox{.xMin = 65535, .yMin = 65535, .xMax = -65535, .yMax = -65535};
 
-    // Define rendering history (used for backtracking).
-    struct {
-        FT_Pos pen_x;
-        FT_BBox bbox;
-    } history[std::size(result.glyphs)] = {};
-
-    // Initialize ellipsis character data.
-    struct {
-        FT_Glyph glyph;
-        FT_BBox bbox;
-        FT_Pos advance_x;
-    } ellipsis = {};
-
-    if(auto glyph = render_glyph(context, 0x2026); glyph != nullptr) {
-        if(FT_Get_Glyph(glyph, &(ellipsis.glyph)) == FT_Err_Ok) {
-            ellipsis.bbox = compute_bbox(glyph);
-            ellipsis.advance_x = (glyph->advance.x / 64);
-        }
-    }
+    // Obtain ellipsis character glyph.
+    auto ellipsis = lookup(0x2026);
+    auto ellipsis_bbox = ((ellipsis != nullptr) ? ellipsis->bbox : FT_BBox{});
 
     // Render text line characters.
-    for(auto i = size_t{0}; auto c : params.text_line) {
-        if(auto glyph = render_glyph(context, c); glyph != nullptr) {
+    for(auto c : params.text_line) {
+        if(auto glyph = lookup(c); glyph != nullptr) {
             // Stretch text line's bounding box.
-            result.bbox = stretch_bbox(result.bbox, compute_bbox(glyph), pen_x);
+            result.bbox = stretch_bbox(result.bbox, glyph->bbox, pen_x);
 
             // Check text line's width.
             if((result.bbox.xMax - result.bbox.xMin) > w_max) {
                 // If it exceeds horizontal bound, then start backtracking and
                 // find a position which can fit the rendered ellipsis
                 // character.
-                for(i = 0; result.n_glyphs > 0;) {
-                    // Destroy the last glyph.
-                    FT_Done_Glyph(result.glyphs[i = --result.n_glyphs]);
+                auto& history = result.history;
+                while(!(history.empty())) {
+                    // Remove the last glyph.
+                    auto last = history.back();
+                    result.glyphs.pop_back();
+                    history.pop_back();
 
                     // Restore pen's position.
-                    pen_x = history[i].pen_x;
+                    pen_x = last.pen_x;
 
                     // Compute text line's bounding box.
-                    result.bbox =
-                        stretch_bbox(history[i].bbox, ellipsis.bbox, pen_x);
+                    result.bbox = stretch_bbox(last.bbox, ellipsis_bbox, pen_x);
 
                     // If the text line fits, then break out of the cycle.
                     if((result.bbox.xMax - result.bbox.xMin) <= w_max) {
@@ -316,56 +850,365 @@ render(text_rendering_context const& context, FT_Pos pen_x, FT_Pos w_max,
                     }
                 }
 
-                // If such position is at the beginning, then restore pen's
-                // initial position and set text line's bounding box to ellipsis
-                // character's bounding box.
-                if(i == 0) {
-                    pen_x = history[0].pen_x;
-                    result.bbox = ellipsis.bbox;
+                // If such position is at the beginning, then set text line's
+                // bounding box to ellipsis character's bounding box.
+                if(history.empty()) {
+                    result.bbox = ellipsis_bbox;
                 }
 
-                // Add rendered ellipsis glyph to the glyph buffer.
-                if(ellipsis.glyph != nullptr) {
-                    if(FT_Glyph_Copy(ellipsis.glyph, &(result.glyphs[i])) ==
-                       FT_Err_Ok) {
-                        // Compute glyph's offset.
-                        reinterpret_cast<FT_BitmapGlyph>(result.glyphs[i])
-                            ->left += static_cast<int>(pen_x);
-
-                        // Increment the number of glyphs in the glyph buffer.
-                        result.n_glyphs = ++i;
-                    }
+                // Add ellipsis glyph to the resulting text line.
+                if(ellipsis != nullptr) {
+                    result.glyphs.push_back(
+                        {.glyph = ellipsis, .pen_x = pen_x});
                 }
 
                 // And break out of the cycle.
                 break;
             }
 
-            // Add rendered glyph to the resulting text line.
-            if(FT_Get_Glyph(glyph, &(result.glyphs[i])) == FT_Err_Ok) {
-                // Compute glyph's offset.
-                reinterpret_cast<FT_BitmapGlyph>(result.glyphs[i])->left +=
-                    static_cast<int>(pen_x);
+            // Add rendered glyph to the resulting text line, and save current
+            // pen position and text line's bounding box.
+            result.glyphs.push_back({.glyph = glyph, .pen_x = pen_x});
+            result.history.push_back({.pen_x = pen_x, .bbox = result.bbox});
+
+            // Advance pen's position.
+            pen_x += glyph->advance_x;
+        }
+    }
+
+    return result;
+}
 
-                // Save current pen position and text line's bounding box.
-                history[i].pen_x = pen_x;
-                history[i].bbox = result.bbox;
+// Renders the given text line. If the glyph atlas is full, then clears the
+// glyph cache, and renders the text line again.
+// Note: The cache can not be cleared while the text line is being rendered,
+// since the rendered text line refers to the cached glyphs.
+static auto
+render(text_rendering_context const& context, FT_Pos pen_x, FT_Pos w_max,
+       struct text_rendering_parameters params)
+    -> struct rendered_text_line const& {
+    for(auto i = 0;; ++i) {
+        // Clear the glyph cache, if the atlas is full.
+        if(context->atlas.is_full) {
+            context->glyph_cache.clear();
+            context->atlas.clear();
+        }
+
+        // Render the text line.
+        // Note: The text line is rendered again at most once: if it does not
+        // fit into the empty atlas, then some of its glyphs are omitted.
+        if(auto const& result = render_once(context, pen_x, w_max, params);
+           !(context->atlas.is_full) || (i == 1)) {
+            return result;
+        }
+    }
+}
 
-                // Increment the number of glyphs in the glyph buffer.
-                result.n_glyphs = ++i;
+////////////////////////////////////////////////////////////////////////////////
+// Glyph blitting utility functions. Each function widens a rectangular region
+// of 8-bit coverage values to 32-bit pixels, and either copies them to the
+// destination, or blends them with destination pixels using the "over"
+// operator: d = s + d - s * d / 255 (for each channel of the pixel).
+//
+// Note: All implementations produce identical results.
+////////////////////////////////////////////////////////////////////////////////
+
+enum struct blit_mode { copy, blend };
+
+struct blit_parameters {
+    // Destination pixels and source coverage values.
+    unsigned char* dst;
+    unsigned char const* src;
+
+    // Pitches of the destination and the source.
+    size_t dst_pitch, src_pitch;
+
+    // Size of the region.
+    int w, h;
+};
+
+using blit_function = void (*)(struct blit_parameters params);
+
+struct blit_functions {
+    blit_function copy, blend;
+};
+
+static auto
+blend(unsigned s, unsigned d) -> unsigned char {
+    // Compute s * d / 255 with rounding.
+    auto t = s * d + 128;
+    return static_cast<unsigned char>(s + d - ((t + (t >> 8)) >> 8));
+}
+
+template <blit_mode Mode>
+static void
+blit_scalar(struct blit_parameters params) {
+    for(auto j = 0; j != params.h; ++j) {
+        auto src = params.src + params.src_pitch * j;
+        auto dst = params.dst + params.dst_pitch * j;
+
+        for(auto k = 0; k != params.w; ++k, ++src) {
+            for(auto i = 0; i != 4; ++i, ++dst) {
+                *dst = ((Mode == blit_mode::copy) ? *src : blend(*src, *dst));
             }
+        }
+    }
+}
 
-            // Advance pen's position.
-            pen_x += (glyph->advance.x / 64);
+#if defined(__x86_64__)
+
+// Note: SSE2 is available on every x86-64 CPU, so SSE2 functions do not need
+// target attributes. They are always inlined, so that AVX2 functions do not
+// mix legacy SSE and AVX instructions.
+[[gnu::always_inline]] static inline auto
+divide_sse2(__m128i x) -> __m128i {
+    // Compute x / 255 with rounding for each 16-bit value.
+    x = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+template <blit_mode Mode>
+[[gnu::always_inline]] static inline void
+store_sse2(unsigned char* dst, __m128i s) {
+    auto p = reinterpret_cast<__m128i*>(dst);
+    if constexpr(Mode == blit_mode::copy) {
+        _mm_storeu_si128(p, s);
+    } else {
+        // Compute s * d / 255 with rounding, using 16-bit arithmetic.
+        auto d = _mm_loadu_si128(p), zero = _mm_setzero_si128();
+        auto q = _mm_packus_epi16(
+            divide_sse2(_mm_mullo_epi16(
+                _mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero))),
+            divide_sse2(_mm_mullo_epi16(
+                _mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero))));
+
+        // Note: The result always fits in 8 bits, so wrapping arithmetic is
+        // exact.
+        _mm_storeu_si128(p, _mm_sub_epi8(_mm_add_epi8(s, d), q));
+    }
+}
+
+template <blit_mode Mode>
+[[gnu::always_inline]] static inline void
+blit_16_sse2(unsigned char* dst, unsigned char const* src) {
+    // Widen 16 coverage values to 32-bit pixels, and store them.
+    auto s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+    auto lo = _mm_unpacklo_epi8(s, s), hi = _mm_unpackhi_epi8(s, s);
+
+    store_sse2<Mode>(dst + 0x00, _mm_unpacklo_epi16(lo, lo));
+    store_sse2<Mode>(dst + 0x10, _mm_unpackhi_epi16(lo, lo));
+    store_sse2<Mode>(dst + 0x20, _mm_unpacklo_epi16(hi, hi));
+    store_sse2<Mode>(dst + 0x30, _mm_unpackhi_epi16(hi, hi));
+}
+
+template <blit_mode Mode>
+[[gnu::always_inline]] static inline void
+blit_4_sse2(unsigned char* dst, unsigned char const* src) {
+    // Widen 4 coverage values to 32-bit pixels, and store them.
+    auto x = int{};
+    std::memcpy(&x, src, sizeof(x));
+
+    auto s = _mm_cvtsi32_si128(x);
+    s = _mm_unpacklo_epi8(s, s);
+
+    store_sse2<Mode>(dst, _mm_unpacklo_epi16(s, s));
+}
+
+template <blit_mode Mode>
+[[gnu::always_inline]] static inline void
+blit_tail_sse2(unsigned char* dst, unsigned char const* src, int n) {
+    // Process fewer than 4 pixels using temporary buffers.
+    unsigned char s[4] = {}, d[16] = {};
+
+    for(auto k = 0; k != n; ++k) {
+        s[k] = src[k];
+        std::memcpy(d + k * 4, dst + k * 4, 4);
+    }
+
+    blit_4_sse2<Mode>(d, s);
+
+    for(auto k = 0; k != n; ++k) {
+        std::memcpy(dst + k * 4, d + k * 4, 4);
+    }
+}
+
+template <blit_mode Mode>
+static void
+blit_sse2(struct blit_parameters params) {
+    for(auto j = 0; j != params.h; ++j) {
+        auto src = params.src + params.src_pitch * j;
+        auto dst = params.dst + params.dst_pitch * j;
+
+        // Process 16 pixels per iteration.
+        auto n = params.w;
+        for(; n >= 16; n -= 16, src += 16, dst += 64) {
+            blit_16_sse2<Mode>(dst, src);
+        }
+
+        // Process remaining pixels.
+        for(; n >= 4; n -= 4, src += 4, dst += 16) {
+            blit_4_sse2<Mode>(dst, src);
         }
+
+        if(n != 0) {
+            blit_tail_sse2<Mode>(dst, src, n);
+        }
+    }
+}
+
+__attribute__((target("avx2"))) static auto
+divide_avx2(__m256i x) -> __m256i {
+    // Compute x / 255 with rounding for each 16-bit value.
+    x = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_srli_epi16(x, 8)), 8);
+}
+
+template <blit_mode Mode>
+__attribute__((target("avx2"))) static void
+store_avx2(unsigned char* dst, __m256i s) {
+    auto p = reinterpret_cast<__m256i*>(dst);
+    if constexpr(Mode == blit_mode::copy) {
+        _mm256_storeu_si256(p, s);
+    } else {
+        // Compute s * d / 255 with rounding, using 16-bit arithmetic.
+        // Note: Unpacking and packing operate within 128-bit lanes, so the
+        // order of the values is preserved.
+        auto d = _mm256_loadu_si256(p), zero = _mm256_setzero_si256();
+        auto q = _mm256_packus_epi16(
+            divide_avx2(_mm256_mullo_epi16(
+                _mm256_unpacklo_epi8(s, zero), _mm256_unpacklo_epi8(d, zero))),
+            divide_avx2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero),
+                                           _mm256_unpackhi_epi8(d, zero))));
+
+        _mm256_storeu_si256(p, _mm256_sub_epi8(_mm256_add_epi8(s, d), q));
     }
+}
 
-    // Free memory.
-    if(ellipsis.glyph != nullptr) {
-        FT_Done_Glyph(ellipsis.glyph);
+template <blit_mode Mode>
+__attribute__((target("avx2"))) static void
+blit_32_avx2(unsigned char* dst, unsigned char const* src) {
+    // Define a mask which replicates each of the first four bytes of the lower
+    // lane (and each of the next four bytes of the upper lane) four times.
+    auto mask = _mm256_setr_epi8( //
+        0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, //
+        4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+
+    // Widen 32 coverage values to 32-bit pixels (8 values at a time), and
+    // store them.
+    for(auto i = 0; i != 4; ++i) {
+        auto x = std::int64_t{};
+        std::memcpy(&x, src + 8 * i, sizeof(x));
+
+        store_avx2<Mode>(
+            dst + 32 * i, _mm256_shuffle_epi8(_mm256_set1_epi64x(x), mask));
     }
+}
 
-    return result;
+template <blit_mode Mode>
+__attribute__((target("avx2"))) static void
+blit_avx2(struct blit_parameters params) {
+    for(auto j = 0; j != params.h; ++j) {
+        auto src = params.src + params.src_pitch * j;
+        auto dst = params.dst + params.dst_pitch * j;
+
+        // Process 32 pixels per iteration.
+        auto n = params.w;
+        for(; n >= 32; n -= 32, src += 32, dst += 128) {
+            blit_32_avx2<Mode>(dst, src);
+        }
+
+        // Process remaining pixels.
+        for(; n >= 16; n -= 16, src += 16, dst += 64) {
+            blit_16_sse2<Mode>(dst, src);
+        }
+
+        for(; n >= 4; n -= 4, src += 4, dst += 16) {
+            blit_4_sse2<Mode>(dst, src);
+        }
+
+        if(n != 0) {
+            blit_tail_sse2<Mode>(dst, src, n);
+        }
+    }
+}
+
+#elif defined(__aarch64__)
+
+// Note: NEON is available on every AArch64 CPU.
+static auto
+divide_neon(uint16x8_t x) -> uint8x8_t {
+    // Compute x / 255 with rounding for each 16-bit value.
+    x = vaddq_u16(x, vdupq_n_u16(128));
+    return vshrn_n_u16(vaddq_u16(x, vshrq_n_u16(x, 8)), 8);
+}
+
+static auto
+blend_neon(uint8x16_t s, uint8x16_t d) -> uint8x16_t {
+    // Compute s * d / 255 with rounding, using 16-bit arithmetic.
+    auto q = vcombine_u8(
+        divide_neon(vmull_u8(vget_low_u8(s), vget_low_u8(d))),
+        divide_neon(vmull_u8(vget_high_u8(s), vget_high_u8(d))));
+
+    // Note: The result always fits in 8 bits, so wrapping arithmetic is exact.
+    return vsubq_u8(vaddq_u8(s, d), q);
+}
+
+template <blit_mode Mode>
+static void
+blit_16_neon(unsigned char* dst, unsigned char const* src) {
+    // Load coverage values.
+    auto s = vld1q_u8(src);
+
+    // Store them to each channel of destination pixels.
+    if constexpr(Mode == blit_mode::copy) {
+        vst4q_u8(dst, (uint8x16x4_t{{s, s, s, s}}));
+    } else {
+        auto d = vld4q_u8(dst);
+        for(auto& x : d.val) {
+            x = blend_neon(s, x);
+        }
+
+        vst4q_u8(dst, d);
+    }
+}
+
+template <blit_mode Mode>
+static void
+blit_neon(struct blit_parameters params) {
+    for(auto j = 0; j != params.h; ++j) {
+        auto src = params.src + params.src_pitch * j;
+        auto dst = params.dst + params.dst_pitch * j;
+
+        // Process 16 pixels per iteration.
+        auto n = params.w;
+        for(; n >= 16; n -= 16, src += 16, dst += 64) {
+            blit_16_neon<Mode>(dst, src);
+        }
+
+        // Process remaining pixels.
+        blit_scalar<Mode>({.dst = dst, .src = src, .w = n, .h = 1});
+    }
+}
+
+#endif
+
+static auto
+select_blit_functions() -> struct blit_functions {
+#if defined(__x86_64__)
+    if(__builtin_cpu_init(); __builtin_cpu_supports("avx2")) {
+        return {.copy = blit_avx2<blit_mode::copy>,
+                .blend = blit_avx2<blit_mode::blend>};
+    }
+
+    return {.copy = blit_sse2<blit_mode::copy>,
+            .blend = blit_sse2<blit_mode::blend>};
+#elif defined(__aarch64__)
+    return {.copy = blit_neon<blit_mode::copy>,
+            .blend = blit_neon<blit_mode::blend>};
+#else
+    return {.copy = blit_scalar<blit_mode::copy>,
+            .blend = blit_scalar<blit_mode::blend>};
+#endif
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -386,20 +1229,43 @@ initialize(struct text_rendering_context_parameters params)
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// Text rendering interface implementation.
+// Glyph atlas interface implementation.
 ////////////////////////////////////////////////////////////////////////////////
 
 auto
-render(text_rendering_context const& context,
-       struct text_rendering_parameters params, struct render_target target)
-    -> struct text_rendering_result {
+describe_glyph_atlas(text_rendering_context const& context)
+    -> struct glyph_atlas_description {
     // Make sure the context is valid.
     if(!context) {
         return {};
     }
 
-    // Make sure the supplied parameters are valid.
-    if((params.font_size < 1) || (params.dpi < 1)) {
+    return {.w = glyph_atlas::w,
+            .h = context->atlas.h,
+            .revision = context->atlas.revision};
+}
+
+void
+limit_glyph_atlas(text_rendering_context const& context, int h_max) {
+    // Make sure the context is valid.
+    if(!context) {
+        return;
+    }
+
+    // Set the limit.
+    // Note: If the atlas is already too large, then it is cleared before
+    // rendering the next text line.
+    auto& atlas = context->atlas;
+    atlas.h_max = std::clamp(h_max, 1, glyph_atlas::h_max_default);
+    atlas.is_full = atlas.is_full || (atlas.h > atlas.h_max);
+}
+
+auto
+render_glyph_atlas(text_rendering_context const& context,
+                   struct render_target target, unsigned long long revision)
+    -> struct glyph_atlas_rows {
+    // Make sure the context is valid.
+    if(!context) {
         return {};
     }
 
@@ -411,90 +1277,360 @@ render(text_rendering_context const& context,
     // Compute render target's pitch, if needed.
     target.pitch = ((target.pitch <= 0) ? (target.w * 4) : target.pitch);
 
-    // Render the glyphs.
-    auto rendered_text_line = render(context, 0, target.w, params);
+    // Find the range of rows which have been modified after the given
+    // revision.
+    auto const& row_revisions = context->atlas.row_revisions;
+    auto is_modified = [revision](auto x) { return x > revision; };
+
+    auto first = std::ranges::find_if(row_revisions, is_modified);
+    auto last = std::ranges::find_if(
+                    row_revisions | std::views::reverse, is_modified)
+                    .base();
+
+    if(first >= last) {
+        return {};
+    }
+
+    // Copy the rows.
+    auto y = static_cast<int>(first - row_revisions.begin());
+    auto y_end = static_cast<int>(last - row_revisions.begin());
+
+    if(auto w = std::min(target.w, glyph_atlas::w),
+       h = std::min(target.h, y_end) - y;
+       (w > 0) && (h > 0)) {
+        select_blit_functions().copy(
+            {.dst = target.pixels + static_cast<size_t>(y) * target.pitch,
+             .src = context->atlas.pixels.data() +
+                    static_cast<size_t>(y) * glyph_atlas::w,
+             .dst_pitch = static_cast<size_t>(target.pitch),
+             .src_pitch = glyph_atlas::w,
+             .w = w,
+             .h = h});
+
+        return {.y = y, .h = h};
+    }
+
+    return {};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Text layout interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+layout(text_rendering_context const& context,
+       struct text_rendering_parameters params, int w, int h)
+    -> struct text_layout_result {
+    // Make sure the context is valid.
+    if(!context) {
+        return {};
+    }
+
+    // Make sure the supplied parameters are valid.
+    if((params.font_size < 1) || (params.dpi < 1) || (w <= 0) || (h <= 0)) {
+        return {};
+    }
+
+    // Look the text line up in the layout cache.
+    auto is_match = [&](cached_layout const& x) {
+        return (x.atlas_generation == context->atlas.generation) &&
+               (x.font_size == params.font_size) && (x.dpi == params.dpi) &&
+               (x.w == w) && (x.h == h) &&
+               std::ranges::equal(x.text_line, params.text_line);
+    };
+
+    if(auto i = std::ranges::find_if(context->layouts, is_match);
+       i != context->layouts.end()) {
+        i->time = ++(context->layout_time);
+        return {.quads = i->quads,
+                .n_code_points_consumed = i->n_code_points_consumed};
+    }
+
+    // Shape the text line and render its glyphs.
+    auto const& rendered_text_line = render(
+        context, 0, w,
+        {.font_size = params.font_size,
+         .dpi = params.dpi,
+         .text_line = shape(context, params.text_line)});
 
     // Obtain the list of rendered glyphs.
-    auto glyphs =
-        std::span{rendered_text_line.glyphs, rendered_text_line.n_glyphs};
+    auto const& glyphs = rendered_text_line.glyphs;
 
-    // Copy glyphs to the render target.
-    if(true) {
-        // Compute baseline's offset.
-        auto baseline_dx = -rendered_text_line.bbox.xMin;
-        auto baseline_dy = -rendered_text_line.y_ref_min;
-
-        // Center the baseline.
-        if(true) {
-            // Compute text line's reference height.
-            auto h =
-                (rendered_text_line.y_ref_max - rendered_text_line.y_ref_min);
-
-            // Update the baseline.
-            if(target.h > h) {
-                if(rendered_text_line.y_ref_min < 0) {
-                    h -= rendered_text_line.y_ref_min;
-                }
+    // Compute baseline's offset.
+    auto baseline_dx = -rendered_text_line.bbox.xMin;
+    auto baseline_dy = -rendered_text_line.y_ref_min;
 
-                baseline_dy += (target.h - h) / 2;
+    // Center the baseline.
+    if(true) {
+        // Compute text line's reference height.
+        auto ref_h =
+            (rendered_text_line.y_ref_max - rendered_text_line.y_ref_min);
+
+        // Update the baseline.
+        if(h > ref_h) {
+            if(rendered_text_line.y_ref_min < 0) {
+                ref_h -= rendered_text_line.y_ref_min;
             }
+
+            baseline_dy += (h - ref_h) / 2;
         }
+    }
 
-        for(auto _ : glyphs) {
-            // Obtain current glyph.
-            auto glyph = reinterpret_cast<FT_BitmapGlyph>(_);
+    // Obtain an entry of the layout cache: either add a new one, or replace
+    // the least recently used one.
+    // Note: Storage of new entries is reserved for typical text lines, so that
+    // replacing an entry does not allocate memory.
+    auto& layout = [&]() -> cached_layout& {
+        if(context->layouts.size() < n_cached_layouts_max) {
+            auto& x = context->layouts.emplace_back();
+            x.text_line.reserve(cached_layout_n_code_points);
+            x.quads.reserve(cached_layout_n_quads);
+
+            return x;
+        }
 
-            // Compute offsets.
-            auto dst_dx = glyph->left + baseline_dx;
-            auto dst_dy = target.h - glyph->top - baseline_dy;
+        return *std::ranges::min_element(
+            context->layouts, {}, &cached_layout::time);
+    }();
+
+    layout.text_line.assign(params.text_line.data(), params.text_line.size());
+    layout.font_size = params.font_size;
+    layout.dpi = params.dpi;
+    layout.w = w;
+    layout.h = h;
+    layout.atlas_generation = context->atlas.generation;
+    layout.n_code_points_consumed = glyphs.size();
+    layout.time = ++(context->layout_time);
+
+    // Compute glyph quads.
+    auto& quads = layout.quads;
+    quads.clear();
+
+    for(auto [glyph, glyph_pen_x] : glyphs) {
+        // Compute offsets.
+        auto dst_dx = glyph->bbox.xMin + glyph_pen_x + baseline_dx;
+        auto dst_dy = h - glyph->bbox.yMax - baseline_dy;
+
+        auto src_dy = ((dst_dy < 0) ? -dst_dy : 0);
+        dst_dy = ((dst_dy < 0) ? 0 : dst_dy);
+
+        // Compute target width based on glyph bitmap's width and the amount of
+        // space left in the render target.
+        auto quad_w = std::min(
+            static_cast<FT_Pos>(glyph->w), static_cast<FT_Pos>(w - dst_dx));
+
+        // Compute target height based on glyph bitmap's height and the amount
+        // of space left in the render target.
+        auto quad_h = std::min(static_cast<FT_Pos>(glyph->h - src_dy),
+                               static_cast<FT_Pos>(h - dst_dy));
+
+        // Add a quad, if the glyph is visible.
+        if((quad_w > 0) && (quad_h > 0)) {
+            quads.push_back(
+                {.dst = {.x = static_cast<int>(dst_dx),
+                         .y = static_cast<int>(dst_dy),
+                         .w = static_cast<int>(quad_w),
+                         .h = static_cast<int>(quad_h)},
+                 .src = {.x = static_cast<int>(
+                             glyph->atlas_offset % glyph_atlas::w),
+                         .y = static_cast<int>(
+                             glyph->atlas_offset / glyph_atlas::w + src_dy),
+                         .w = static_cast<int>(quad_w),
+                         .h = static_cast<int>(quad_h)}});
+        }
+    }
 
-            auto src_dy = ((dst_dy < 0) ? -dst_dy : 0);
-            dst_dy = ((dst_dy < 0) ? 0 : dst_dy);
+    // Return the result.
+    return {.quads = quads, .n_code_points_consumed = glyphs.size()};
+}
 
-            // Compute target width based on glyph bitmap's width and the amount
-            // of space left in the render target.
-            auto w = std::min(static_cast<FT_Pos>(glyph->bitmap.width),
-                              static_cast<FT_Pos>(target.w - dst_dx));
+auto
+layout(text_rendering_context const& context,
+       struct text_list_rendering_parameters params, int w, int h)
+    -> struct text_layout_result {
+    // Make sure the context is valid.
+    if(!context) {
+        return {};
+    }
 
-            // Compute target height based on glyph bitmap's height and the
-            // amount of space left in the render target.
-            auto h = std::min(static_cast<FT_Pos>(glyph->bitmap.rows - src_dy),
-                              static_cast<FT_Pos>(target.h - dst_dy));
+    // Make sure the supplied parameters are valid.
+    if((params.row_h <= 0) || (w <= 0) || (h <= 0)) {
+        return {};
+    }
 
-            // Compute glyph bitmap's pitch.
-            auto bitmap_pitch =
-                ((glyph->bitmap.pitch < 0) ? -(glyph->bitmap.pitch)
-                                           : +(glyph->bitmap.pitch));
+    // Lay the rows out.
+    auto& quads = context->row_quads;
+    auto n_code_points_consumed = size_t{};
 
-            // Copy glyph's bitmap to the render target.
-            if((w > 0) && (h > 0)) {
-                auto line_src = glyph->bitmap.buffer + (bitmap_pitch * src_dy);
-                for(auto j = dst_dy; j < (dst_dy + h); ++j) {
-                    auto src = line_src;
-                    auto dst = target.pixels + target.pitch * j + 4 * dst_dx;
+    // Note: If the atlas is cleared while the rows are being laid out, then
+    // glyph quads of the previous rows become invalid, and the rows are laid
+    // out again.
+    for(auto n_attempts = 0; n_attempts != 2; ++n_attempts) {
+        auto const atlas_generation = context->atlas.generation;
 
-                    for(auto k = 0; k != w; ++k, dst += 4) {
-                        std::fill_n(dst, 4, *(src++));
-                    }
+        quads.clear();
+        n_code_points_consumed = 0;
 
-                    line_src += bitmap_pitch;
-                }
+        for(auto y = 0; auto text_line : params.text_lines) {
+            // Stop if the row does not fit in the render target.
+            if(y >= h) {
+                break;
             }
+
+            // Lay the row out.
+            auto r = layout(context,
+                            {.font_size = params.font_size,
+                             .dpi = params.dpi,
+                             .text_line = text_line},
+                            w, std::min(params.row_h, h - y));
+
+            // Add row's glyph quads.
+            for(auto quad : r.quads) {
+                quad.dst.y += y;
+                quads.push_back(quad);
+            }
+
+            // Advance to the next row.
+            n_code_points_consumed += r.n_code_points_consumed;
+            y += params.row_h;
+        }
+
+        if(context->atlas.generation == atlas_generation) {
+            break;
         }
     }
 
-    // Free memory.
-    for(auto glyph : glyphs) {
-        FT_Done_Glyph(glyph);
+    // Return the result.
+    return {.quads = quads, .n_code_points_consumed = n_code_points_consumed};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Text rendering interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+render(text_rendering_context const& context,
+       struct text_rendering_parameters params, struct render_target target)
+    -> struct text_rendering_result {
+    // Make sure the supplied render target is valid.
+    if((target.pixels == nullptr) || (target.w <= 0) || (target.h <= 0)) {
+        return {};
+    }
+
+    // Compute render target's pitch, if needed.
+    target.pitch = ((target.pitch <= 0) ? (target.w * 4) : target.pitch);
+
+    // Select glyph blitting functions.
+    static auto const blit = select_blit_functions();
+
+    // Lay the text out.
+    auto text_layout = layout(context, params, target.w, target.h);
+
+    // Initialize damaged region of the render target.
+    auto damage =
+        FT_BBox{.xMin = target.w, .yMin = target.h, .xMax = 0, .yMax = 0};
+
+    // Copy glyphs to the render target.
+    for(auto const& [dst, src] : text_layout.quads) {
+        // Note: If the bitmap overlaps previously copied bitmaps, then it is
+        // blended with them instead.
+        auto f = ((dst.x >= damage.xMax) ? blit.copy : blit.blend);
+        f({.dst = target.pixels + target.pitch * dst.y + 4 * dst.x,
+           .src = context->atlas.pixels.data() + glyph_atlas::w * src.y + src.x,
+           .dst_pitch = static_cast<size_t>(target.pitch),
+           .src_pitch = glyph_atlas::w,
+           .w = dst.w,
+           .h = dst.h});
+
+        // Stretch damaged region.
+        damage = stretch_bbox(damage,
+                              {.xMin = dst.x,
+                               .yMin = dst.y,
+                               .xMax = dst.x + dst.w,
+                               .yMax = dst.y + dst.h},
+                              0);
+    }
+
+    // Make sure the damaged region is valid.
+    if((damage.xMin >= damage.xMax) || (damage.yMin >= damage.yMax)) {
+        damage = {};
+    }
+
+    // Return the result.
+    return {.rectangle = //
+            {.x = damage.xMin,
+             .y = damage.yMin,
+             .w = damage.xMax - damage.xMin,
+             .h = damage.yMax - damage.yMin},
+            .n_code_points_consumed = text_layout.n_code_points_consumed};
+}
+
+auto
+render(text_rendering_context const& context,
+       struct text_list_rendering_parameters params,
+       struct render_target target) -> struct text_rendering_result {
+    // Make sure the supplied render target is valid.
+    if((target.pixels == nullptr) || (target.w <= 0) || (target.h <= 0)) {
+        return {};
+    }
+
+    // Make sure the supplied parameters are valid.
+    if(params.row_h <= 0) {
+        return {};
+    }
+
+    // Compute render target's pitch, if needed.
+    target.pitch = ((target.pitch <= 0) ? (target.w * 4) : target.pitch);
+
+    // Initialize damaged region of the render target.
+    auto damage =
+        FT_BBox{.xMin = target.w, .yMin = target.h, .xMax = 0, .yMax = 0};
+
+    // Render the rows.
+    auto n_code_points_consumed = size_t{};
+    for(auto y = 0; auto text_line : params.text_lines) {
+        // Stop if the row does not fit in the render target.
+        if(y >= target.h) {
+            break;
+        }
+
+        // Render the row to the corresponding region of the render target.
+        auto r = render(context,
+                        {.font_size = params.font_size,
+                         .dpi = params.dpi,
+                         .text_line = text_line},
+                        {.pixels = target.pixels + target.pitch * y,
+                         .w = target.w,
+                         .h = std::min(params.row_h, target.h - y),
+                         .pitch = target.pitch});
+
+        // Stretch damaged region.
+        if(auto const& x = r.rectangle; (x.w > 0) && (x.h > 0)) {
+            damage = stretch_bbox(damage,
+                                  {.xMin = x.x,
+                                   .yMin = x.y + y,
+                                   .xMax = x.x + x.w,
+                                   .yMax = x.y + y + x.h},
+                                  0);
+        }
+
+        // Advance to the next row.
+        n_code_points_consumed += r.n_code_points_consumed;
+        y += params.row_h;
+    }
+
+    // Make sure the damaged region is valid.
+    if((damage.xMin >= damage.xMax) || (damage.yMin >= damage.yMax)) {
+        damage = {};
     }
 
     // Return the result.
     return {.rectangle = //
-            {.x = rendered_text_line.bbox.xMin,
-             .y = rendered_text_line.bbox.yMin,
-             .w = rendered_text_line.bbox.xMax - rendered_text_line.bbox.xMin,
-             .h = rendered_text_line.bbox.yMax - rendered_text_line.bbox.yMin},
-            .n_code_points_consumed = glyphs.size()};
+            {.x = damage.xMin,
+             .y = damage.yMin,
+             .w = damage.xMax - damage.xMin,
+             .h = damage.yMax - damage.yMin},
+            .n_code_points_consumed = n_code_points_consumed};
 }
 
 } // namespace rose
@@ -6,6 +6,8 @@
 #ifndef H_61F1843D6BC640C4B7099A867B0DCCD9
 #define H_61F1843D6BC640C4B7099A867B0DCCD9
 
+#include "filesystem.hh"
+
 #include <cstddef>
 #include <memory>
 
@@ -52,6 +54,14 @@ struct text_rendering_context_parameters {
     // A range of binary font data. These data are moved into the context upon
     // initialization.
     std::span<std::vector<unsigned char>> fonts;
+
+    // A range of memory-mapped font files, which follow the fonts above in
+    // the order of fallback. These mappings are moved into the context upon
+    // initialization.
+    // Note: Font faces of the files are opened on demand, when a code point
+    // is not found in any of the preceding faces. If no fonts are given
+    // above, then the first file is opened upon initialization.
+    std::span<filesystem::file_mapping> font_files;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -74,22 +84,87 @@ struct text_rendering_parameters {
     // Font size, DPI.
     int font_size, dpi;
 
-    // Line of text to render.
+    // Line of text to render (in logical order).
     std::span<char32_t> text_line;
 };
 
+////////////////////////////////////////////////////////////////////////////////
+// Text list rendering parameters. The list consists of rows of the given
+// height, which are placed from top to bottom. Each row contains one line of
+// text. Rows which do not fit into the render target are omitted.
+////////////////////////////////////////////////////////////////////////////////
+
+struct text_list_rendering_parameters {
+    // Font size, DPI.
+    int font_size, dpi;
+
+    // Height of each row.
+    int row_h;
+
+    // Lines of text to render (in logical order).
+    std::span<std::span<char32_t> const> text_lines;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 // Text rendering result.
 ////////////////////////////////////////////////////////////////////////////////
 
 struct text_rendering_result {
     // Rectangle which defines the damaged region in the render target after
-    // text rendering is complete.
+    // text rendering is complete. The rectangle is specified in render target's
+    // coordinates, and is empty if nothing has been drawn.
     struct {
         long x, y, w, h;
     } rectangle;
 
     // Number of code points consumed from the text line.
+    // Note: For text lists this is the total number over all rows.
+    size_t n_code_points_consumed;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Glyph atlas description. The atlas is an image which contains 8-bit coverage
+// values of all glyphs rendered so far. Its revision number changes each time
+// its contents change.
+////////////////////////////////////////////////////////////////////////////////
+
+struct glyph_atlas_description {
+    // Width and height of the atlas.
+    int w, h;
+
+    // Revision number.
+    unsigned long long revision;
+};
+
+// Range of rows of the glyph atlas.
+struct glyph_atlas_rows {
+    int y, h;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Glyph quad. Maps a region of the glyph atlas to a region of the render
+// target.
+////////////////////////////////////////////////////////////////////////////////
+
+struct glyph_quad {
+    // Destination and source rectangles. Both rectangles have the same size.
+    struct {
+        int x, y, w, h;
+    } dst, src;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Text layout result.
+////////////////////////////////////////////////////////////////////////////////
+
+struct text_layout_result {
+    // A range of glyph quads.
+    // Note: The range is owned by the context, and is valid until the next
+    // call to layout or rendering functions.
+    std::span<struct glyph_quad const> quads;
+
+    // Number of code points consumed from the text line.
+    // Note: For text lists this is the total number over all rows.
     size_t n_code_points_consumed;
 };
 
@@ -101,6 +176,45 @@ auto
 initialize(struct text_rendering_context_parameters params)
     -> text_rendering_context;
 
+////////////////////////////////////////////////////////////////////////////////
+// Glyph atlas interface.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+describe_glyph_atlas(text_rendering_context const& context)
+    -> struct glyph_atlas_description;
+
+// Limits the height of the glyph atlas (e.g., to the maximum texture height).
+// When the atlas is full, the glyph cache is cleared before rendering the next
+// text line.
+void
+limit_glyph_atlas(text_rendering_context const& context, int h_max);
+
+// Copies the rows of the glyph atlas which have been modified after the given
+// revision to the given render target (cropping them, if needed). If the given
+// revision is zero, then the whole atlas is copied. Returns the range which
+// contains all copied rows (other rows of the target are left intact).
+auto
+render_glyph_atlas(text_rendering_context const& context,
+                   struct render_target target,
+                   unsigned long long revision = 0) -> struct glyph_atlas_rows;
+
+////////////////////////////////////////////////////////////////////////////////
+// Text layout interface. Computes the list of glyph quads which represent the
+// given text line in a render target of the given size. Glyphs which are not
+// in the atlas yet are added to it.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+layout(text_rendering_context const& context,
+       struct text_rendering_parameters params, int w, int h)
+    -> struct text_layout_result;
+
+auto
+layout(text_rendering_context const& context,
+       struct text_list_rendering_parameters params, int w, int h)
+    -> struct text_layout_result;
+
 ////////////////////////////////////////////////////////////////////////////////
 // Text rendering interface.
 ////////////////////////////////////////////////////////////////////////////////
@@ -110,6 +224,11 @@ render(text_rendering_context const& context,
        struct text_rendering_parameters params, struct render_target target)
     -> struct text_rendering_result;
 
+auto
+render(text_rendering_context const& context,
+       struct text_list_rendering_parameters params,
+       struct render_target target) -> struct text_rendering_result;
+
 } // namespace rose
 
 #endif // H_61F1843D6BC640C4B7099A867B0DCCD9
@@ -8,15 +8,106 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <span>
+#include <vector>
 
 namespace rose {
 
 ////////////////////////////////////////////////////////////////////////////////
-// Theme initialization interface implementation.
+// Configuration files of the theme.
 ////////////////////////////////////////////////////////////////////////////////
 
-auto
-initialize_theme() -> struct theme {
+struct theme_files {
+    // Contents of the files (in the order of their priority), and their hash.
+    std::vector<unsigned char> data[2];
+    std::uint64_t hash;
+};
+
+// Computes 64-bit FNV-1a hash of the given data, starting with the given hash.
+static auto
+compute_hash(std::uint64_t hash, std::span<unsigned char const> data)
+    -> std::uint64_t {
+    for(auto x : data) {
+        hash = (hash ^ x) * 0x00000100000001B3;
+    }
+
+    return hash;
+}
+
+// Reads configuration files of the theme.
+// Note: Each file is read in one shot.
+static auto
+read_theme_files() -> struct theme_files {
+    // Specify configuration paths.
+    // Note: The paths do not change, so they are computed only once.
+    static auto const paths = [] {
+        auto home = std::getenv("HOME");
+        return std::vector<std::filesystem::path>{
+            ((home != nullptr)
+                 ? std::filesystem::path{home} / ".config/rosewm/theme"
+                 : std::filesystem::path{}),
+            "/etc/rosewm/theme"};
+    }();
+
+    // Read the files and compute their hash.
+    // Note: The size of each file is also hashed, so that the contents of the
+    // files can not be confused with each other.
+    auto result = theme_files{.hash = 0xCBF29CE484222325};
+    for(auto i = size_t{}; i != std::size(result.data); ++i) {
+        if(!(paths[i].empty())) {
+            result.data[i] = filesystem::read(paths[i]);
+        }
+
+        auto size = static_cast<std::uint64_t>(result.data[i].size());
+        result.hash = compute_hash(
+            result.hash,
+            {reinterpret_cast<unsigned char const*>(&size), sizeof(size)});
+        result.hash = compute_hash(result.hash, result.data[i]);
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Theme parsing utility function.
+////////////////////////////////////////////////////////////////////////////////
+
+// Reads the given theme from the given contents of a configuration file.
+// Returns false if the contents are truncated.
+static auto
+parse_theme(struct theme& theme, std::span<unsigned char const> data)
+    -> bool {
+    // Read font size.
+    theme.font_size = std::clamp(static_cast<int>(data[0]), 1, 144);
+
+    // Skip panel data.
+    data = data.subspan(std::min(data.size(), size_t{3}));
+
+    // Read color scheme.
+    auto& x = theme.color_scheme;
+    for(auto color :
+        {&x.panel_background, &x.panel_foreground, &x.panel_highlight,
+         &x.menu_background, &x.menu_foreground, &x.menu_highlight0,
+         &x.menu_highlight1, &x.surface_background0, &x.surface_background1,
+         &x.surface_resizing_background0, &x.surface_resizing_background1,
+         &x.surface_resizing, &x.workspace_background}) {
+        if(data.size() < sizeof(color->rgba)) {
+            return false;
+        }
+
+        std::copy_n(data.begin(), sizeof(color->rgba), color->rgba);
+        data = data.subspan(sizeof(color->rgba));
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Theme initialization utility function.
+////////////////////////////////////////////////////////////////////////////////
+
+static auto
+initialize_theme(struct theme_files const& files) -> struct theme {
     // Initialize default theme.
     auto theme = (struct theme){
         .font_size = 16,
@@ -33,50 +124,40 @@ initialize_theme() -> struct theme {
             .surface_resizing_background0 = {0xCC, 0xCC, 0xCC, 0x80},
             .surface_resizing_background1 = {0x99, 0x99, 0x99, 0x80},
             .surface_resizing = {0x1E, 0x1E, 0x1E, 0x80},
-            .workspace_background = {0x33, 0x33, 0x33, 0xFF}}};
-
-    // Specify configuration paths.
-    std::filesystem::path paths[] = {
-        std::string{std::getenv("HOME")} + "/.config/rosewm/theme",
-        "/etc/rosewm/theme"};
-
-    // Try reading theme from configuration paths.
-    for(auto const& path : paths) {
-        if(auto file = filesystem::file_stream{std::fopen(path.c_str(), "rb")};
-           file) {
-            // Read font size.
-            theme.font_size = std::fgetc(file.get());
-            theme.font_size = std::clamp(theme.font_size, 1, 144);
-
-            // Skip panel data.
-            std::fgetc(file.get());
-            std::fgetc(file.get());
-
-#define read_color_(color)                                          \
-    if(fread(color.rgba, sizeof(color.rgba), 1, file.get()) != 1) { \
-        return theme;                                               \
-    }
+            .workspace_background = {0x33, 0x33, 0x33, 0xFF}},
+        .hash = files.hash};
 
-            // Read color scheme.
-            read_color_(theme.color_scheme.panel_background);
-            read_color_(theme.color_scheme.panel_foreground);
-            read_color_(theme.color_scheme.panel_highlight);
-            read_color_(theme.color_scheme.menu_background);
-            read_color_(theme.color_scheme.menu_foreground);
-            read_color_(theme.color_scheme.menu_highlight0);
-            read_color_(theme.color_scheme.menu_highlight1);
-            read_color_(theme.color_scheme.surface_background0);
-            read_color_(theme.color_scheme.surface_background1);
-            read_color_(theme.color_scheme.surface_resizing_background0);
-            read_color_(theme.color_scheme.surface_resizing_background1);
-            read_color_(theme.color_scheme.surface_resizing);
-            read_color_(theme.color_scheme.workspace_background);
-
-#undef read_color_
+    // Try reading theme from configuration files.
+    // Note: If a file is truncated, then the remaining files are ignored.
+    for(auto const& data : files.data) {
+        if(!(data.empty()) && !parse_theme(theme, data)) {
+            break;
         }
     }
 
     return theme;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Theme initialization interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+auto
+initialize_theme() -> struct theme {
+    return initialize_theme(read_theme_files());
+}
+
+auto
+reload_theme(struct theme& theme) -> bool {
+    // Read configuration files, and make sure they have changed.
+    auto files = read_theme_files();
+    if(files.hash == theme.hash) {
+        return false;
+    }
+
+    // Read the theme again.
+    theme = initialize_theme(files);
+    return true;
+}
+
 } // namespace rose
@@ -6,6 +6,8 @@
 #ifndef H_2F106E4061E0481D847FEC432466A848
 #define H_2F106E4061E0481D847FEC432466A848
 
+#include <cstdint>
+
 namespace rose {
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -43,6 +45,10 @@ struct color_scheme {
 struct theme {
     int font_size;
     struct color_scheme color_scheme;
+
+    // Hash of the contents of the configuration files which the theme has been
+    // read from.
+    std::uint64_t hash;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -52,6 +58,11 @@ struct theme {
 auto
 initialize_theme() -> struct theme;
 
+// Reads the given theme again, if the contents of its configuration files have
+// changed. Returns true if the theme has been read again.
+auto
+reload_theme(struct theme& theme) -> bool;
+
 } // namespace rose
 
 #endif // H_2F106E4061E0481D847FEC432466A848
@@ -0,0 +1,144 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+#include "filesystem.hh"
+#include "tracing.hh"
+
+#include <atomic>
+#include <span>
+#include <string>
+
+namespace rose {
+
+////////////////////////////////////////////////////////////////////////////////
+// Trace buffer.
+////////////////////////////////////////////////////////////////////////////////
+
+struct trace_record {
+    // Sequence number of the record plus one, or zero if the record is being
+    // written.
+    std::atomic<std::uint64_t> sequence;
+
+    // Start time and duration of the event (in nanoseconds), its error code,
+    // and its type.
+    std::atomic<std::int64_t> t, duration;
+    std::atomic<std::int32_t> error;
+    std::atomic<std::uint8_t> event;
+};
+
+// Note: The number of records must be a power of two.
+static constexpr auto n_trace_records = std::uint64_t{4096};
+
+static struct {
+    trace_record records[n_trace_records];
+    std::atomic<std::uint64_t> n_events;
+} trace_buffer = {};
+
+////////////////////////////////////////////////////////////////////////////////
+// Tracing interface implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+void
+trace(enum trace_event x, trace_clock::time_point t,
+      std::chrono::nanoseconds duration, int error) noexcept {
+    using std::memory_order_relaxed;
+
+    // Obtain the next record.
+    auto i = trace_buffer.n_events.fetch_add(1, memory_order_relaxed);
+    auto& record = trace_buffer.records[i & (n_trace_records - 1)];
+
+    // Write the event.
+    // Note: The record is marked as incomplete while it is being written.
+    record.sequence.store(0, memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    record.t.store(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            t.time_since_epoch())
+            .count(),
+        memory_order_relaxed);
+    record.duration.store(duration.count(), memory_order_relaxed);
+    record.error.store(error, memory_order_relaxed);
+    record.event.store(static_cast<std::uint8_t>(x), memory_order_relaxed);
+
+    record.sequence.store(i + 1, std::memory_order_release);
+}
+
+auto
+dump_trace(std::filesystem::path const& path) -> bool {
+    using std::memory_order_relaxed;
+
+    // Define event names.
+    static constexpr char const* event_names[] = {
+        "ipc_receive",    "request", "input",  "database_lookup",
+        "text_rendering", "present", "launch"};
+
+    // Define a function which appends the given time in microseconds.
+    auto append_time = [](std::string& string, std::int64_t t) {
+        auto fraction = std::to_string(1000 + (t % 1000));
+        string.append(std::to_string(t / 1000));
+        string.append(".").append(fraction.substr(1));
+    };
+
+    // Write the events.
+    auto result = std::string{"{\"traceEvents\":["};
+    auto n = trace_buffer.n_events.load();
+    auto i = ((n > n_trace_records) ? (n - n_trace_records) : 0);
+
+    for(auto is_first = true; i != n; ++i) {
+        auto& record = trace_buffer.records[i & (n_trace_records - 1)];
+
+        // Read the record.
+        auto sequence = record.sequence.load(std::memory_order_acquire);
+        auto t = record.t.load(memory_order_relaxed);
+        auto duration = record.duration.load(memory_order_relaxed);
+        auto error = record.error.load(memory_order_relaxed);
+        auto event = record.event.load(memory_order_relaxed);
+
+        // Skip the record if it is being overwritten, or if it has been
+        // overwritten while it was being read.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if((sequence != (i + 1)) ||
+           (record.sequence.load(memory_order_relaxed) != sequence) ||
+           (event >= std::size(event_names))) {
+            continue;
+        }
+
+        // Write the event.
+        result.append(is_first ? "" : ",");
+        result.append("{\"name\":\"").append(event_names[event]);
+        result.append((duration > 0) ? "\",\"ph\":\"X\"" : "\",\"ph\":\"i\"");
+        result.append(",\"pid\":1,\"tid\":1,\"ts\":");
+        append_time(result, t);
+
+        if(duration > 0) {
+            result.append(",\"dur\":");
+            append_time(result, duration);
+        } else {
+            result.append(",\"s\":\"g\"");
+        }
+
+        // Note: The error code is written as an argument of the event.
+        if(error != 0) {
+            result.append(",\"args\":{\"error\":");
+            result.append(std::to_string(error)).append("}");
+        }
+
+        result.append("}");
+        is_first = false;
+    }
+
+    result.append("]}\n");
+
+    // Write the file.
+    auto error = std::error_code{};
+    std::filesystem::create_directories(path.parent_path(), error);
+
+    return filesystem::write(
+        path, {std::span{reinterpret_cast<unsigned char const*>(result.data()),
+                         result.size()}});
+}
+
+} // namespace rose
@@ -0,0 +1,70 @@
+// Copyright Nezametdinov E. Ildus 2023.
+// Distributed under the GNU General Public License, Version 3.
+// (See accompanying file LICENSE_GPL_3_0.txt or copy at
+// https://www.gnu.org/licenses/gpl-3.0.txt)
+//
+#ifndef H_B3C85C50FDAA4F24B9D37DFC6550D534
+#define H_B3C85C50FDAA4F24B9D37DFC6550D534
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+
+namespace rose {
+
+////////////////////////////////////////////////////////////////////////////////
+// Trace event.
+////////////////////////////////////////////////////////////////////////////////
+
+enum struct trace_event : std::uint8_t {
+    // IPC packets have been received.
+    ipc_receive,
+
+    // IPC requests have been dequeued by the main thread.
+    request,
+
+    // Keyboard or text input has been dequeued by the main thread.
+    input,
+
+    // Suggestions have been looked up in the database.
+    database_lookup,
+
+    // Text has been laid out and rendered.
+    text_rendering,
+
+    // A frame has been presented.
+    present,
+
+    // Executor process has launched a command.
+    launch
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Tracing interface. Events are recorded to a fixed-size ring buffer: when the
+// buffer is full, the oldest events are overwritten. Recording is lock-free,
+// and can be done from any thread.
+////////////////////////////////////////////////////////////////////////////////
+
+using trace_clock = std::chrono::steady_clock;
+
+// Records an event which has started at the given moment, and has lasted for
+// the given amount of time. Non-zero error code marks the event as failed
+// (e.g., a launch which has failed with the given errno).
+void
+trace(enum trace_event x, trace_clock::time_point t,
+      std::chrono::nanoseconds duration = {}, int error = 0) noexcept;
+
+// Records an instant event which happens now.
+inline void
+trace(enum trace_event x) noexcept {
+    trace(x, trace_clock::now());
+}
+
+// Writes recorded events to the file with the given path in Chrome's trace
+// event format (JSON).
+auto
+dump_trace(std::filesystem::path const& path) -> bool;
+
+} // namespace rose
+
+#endif // H_B3C85C50FDAA4F24B9D37DFC6550D534
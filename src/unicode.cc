@@ -5,8 +5,15 @@
 //
 #include "unicode.hh"
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include <algorithm>
-#include <fribidi/fribidi.h>
+#include <cstdint>
+#include <cstring>
 
 namespace rose {
 
@@ -127,23 +134,97 @@ utf8_decode(std::u8string_view string) -> utf8_decoding_result {
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// String conversion interface implementation.
+// ASCII conversion utility functions. Convert the leading ASCII characters of
+// the given block of 16 code units, and return their number.
 ////////////////////////////////////////////////////////////////////////////////
 
-auto
-convert_utf8_to_utf32(std::u8string_view string) -> utf32_string_buffer {
-    auto r = (struct utf32_string_buffer){};
+static constexpr auto ascii_block_size = size_t{16};
+
+// Converts the leading ASCII characters one by one.
+static auto
+convert_ascii_prefix(char8_t const* src, char32_t* dst) noexcept -> size_t {
+    auto n = size_t{};
+    for(; (n != ascii_block_size) && (src[n] <= 0x7F); ++n) {
+        dst[n] = src[n];
+    }
+
+    return n;
+}
+
+#if defined(__x86_64__)
+
+static auto
+convert_ascii_block(char8_t const* src, char32_t* dst) noexcept -> size_t {
+    auto s = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src));
+    if(_mm_movemask_epi8(s) != 0) {
+        return convert_ascii_prefix(src, dst);
+    }
+
+    auto zero = _mm_setzero_si128();
+    auto lo = _mm_unpacklo_epi8(s, zero), hi = _mm_unpackhi_epi8(s, zero);
+
+    auto p = reinterpret_cast<__m128i*>(dst);
+    _mm_storeu_si128(p + 0, _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128(p + 1, _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128(p + 2, _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128(p + 3, _mm_unpackhi_epi16(hi, zero));
+
+    return ascii_block_size;
+}
+
+#elif defined(__aarch64__)
+
+static auto
+convert_ascii_block(char8_t const* src, char32_t* dst) noexcept -> size_t {
+    auto s = vld1q_u8(reinterpret_cast<std::uint8_t const*>(src));
+    if(vmaxvq_u8(s) > 0x7F) {
+        return convert_ascii_prefix(src, dst);
+    }
+
+    auto lo = vmovl_u8(vget_low_u8(s)), hi = vmovl_u8(vget_high_u8(s));
+
+    auto p = reinterpret_cast<std::uint32_t*>(dst);
+    vst1q_u32(p + 0x0, vmovl_u16(vget_low_u16(lo)));
+    vst1q_u32(p + 0x4, vmovl_u16(vget_high_u16(lo)));
+    vst1q_u32(p + 0x8, vmovl_u16(vget_low_u16(hi)));
+    vst1q_u32(p + 0xC, vmovl_u16(vget_high_u16(hi)));
+
+    return ascii_block_size;
+}
+
+#else
+
+static auto
+convert_ascii_block(char8_t const* src, char32_t* dst) noexcept -> size_t {
+    std::uint64_t words[2];
+    std::memcpy(words, src, sizeof(words));
 
-    // Decode the given string.
-    while((r.size < std::size(r.data)) && !(string.empty())) {
+    if(((words[0] | words[1]) & 0x8080808080808080) != 0) {
+        return convert_ascii_prefix(src, dst);
+    }
+
+    std::copy_n(src, ascii_block_size, dst);
+    return ascii_block_size;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// UTF-8 decoding iterator implementation.
+////////////////////////////////////////////////////////////////////////////////
+
+void
+utf8_decoding_iterator::advance_() noexcept {
+    for(this->is_end_ = true; !(this->string_.empty());) {
         // Decode the next character.
-        auto d = utf8_decode(string);
+        auto d = utf8_decode(this->string_);
 
         // Shrink the string.
-        string.remove_prefix(d.n);
+        this->string_.remove_prefix(d.n);
 
-        // If the code sequence is incomplete, then break out of the cycle.
+        // If the code sequence is incomplete, then stop decoding.
         if(d.x == utf8_decoding_incomplete) {
+            this->string_ = {};
             break;
         }
 
@@ -153,33 +234,60 @@ convert_utf8_to_utf32(std::u8string_view string) -> utf32_string_buffer {
         }
 
         // Save successfully decoded character.
-        r.data[r.size++] = d.x;
+        this->x_ = d.x;
+        this->is_end_ = false;
+        break;
     }
+}
 
-    // Add ellipsis to the end of the decoded string, if needed.
-    if(!(string.empty()) && (r.size == std::size(r.data))) {
-        r.data[std::size(r.data) - 1] = 0x2026;
-    }
+////////////////////////////////////////////////////////////////////////////////
+// String conversion interface implementation.
+////////////////////////////////////////////////////////////////////////////////
 
-    // Apply Unicode Bidirectional Algorithm.
-    if(true) {
-        FriBidiChar buffer_dst[std::size(r.data)] = {};
-        if(auto base_dir = static_cast<FriBidiParType>(FRIBIDI_TYPE_ON); true) {
-            // Copy the UTF-32 string into the input buffer.
-            FriBidiChar buffer_src[std::size(r.data)] = {};
-            std::ranges::copy(std::span<char32_t const>{r}, buffer_src);
-
-            // Run the algorithm.
-            fribidi_log2vis(buffer_src, static_cast<FriBidiStrIndex>(r.size),
-                            &base_dir, buffer_dst, nullptr, nullptr, nullptr);
+auto
+convert_utf8_to_utf32(std::u8string_view string, std::span<char32_t> result)
+    -> size_t {
+    auto n = size_t{};
+    for(auto i = size_t{}; (i != string.size()) && (n != result.size());) {
+        // Convert leading ASCII characters of the next block, if possible.
+        if(std::min(string.size() - i, result.size() - n) >= ascii_block_size) {
+            auto k = convert_ascii_block(string.data() + i, result.data() + n);
+            i += k;
+            n += k;
+
+            if(k == ascii_block_size) {
+                continue;
+            }
+        }
+
+        // Decode the next code point.
+        auto d = utf8_decode(string.substr(i));
+
+        // If the code sequence is incomplete, then stop decoding.
+        if(d.x == utf8_decoding_incomplete) {
+            break;
         }
 
-        // Copy algorithm's output back to the resulting UTF-32 string.
-        std::ranges::copy(std::span{buffer_dst, r.size}, r.data);
+        // Save successfully decoded character, and skip the error, if any.
+        if(d.x != utf8_decoding_error) {
+            result[n++] = d.x;
+        }
+
+        i += d.n;
+    }
+
+    return n;
+}
+
+void
+convert_utf8_to_utf32(std::u8string_view string, utf32_string_buffer& result) {
+    // Note: The number of code points never exceeds the number of code units
+    // of the given string.
+    if(result.data.size() < string.size()) {
+        result.data.resize(string.size());
     }
 
-    // Return decoded string.
-    return r;
+    result.data.resize(convert_utf8_to_utf32(string, result.data));
 }
 
 } // namespace rose
@@ -7,7 +7,10 @@
 #define H_197460BD03794BAE9CDDF38674FF8EF9
 
 #include <cstddef>
+#include <iterator>
+#include <ranges>
 #include <span>
+#include <string>
 #include <string_view>
 
 namespace rose {
@@ -19,7 +22,85 @@ namespace rose {
 using std::size_t;
 
 ////////////////////////////////////////////////////////////////////////////////
-// UTF-32 encoded Unicode string buffer.
+// UTF-8 decoding iterator. Decodes the code points of the given string on
+// demand. Invalid code sequences are skipped, and decoding stops at the first
+// incomplete code sequence.
+////////////////////////////////////////////////////////////////////////////////
+
+struct utf8_decoding_iterator {
+    ////////////////////////////////////////////////////////////////////////////
+    // Iterator traits.
+    ////////////////////////////////////////////////////////////////////////////
+
+    using value_type = char32_t;
+    using difference_type = std::ptrdiff_t;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Construction/destruction.
+    ////////////////////////////////////////////////////////////////////////////
+
+    utf8_decoding_iterator() = default;
+
+    utf8_decoding_iterator(std::u8string_view string) noexcept
+        : string_{string} {
+        this->advance_();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Access operator.
+    ////////////////////////////////////////////////////////////////////////////
+
+    auto
+    operator*() const noexcept -> char32_t {
+        return this->x_;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Increment operators.
+    ////////////////////////////////////////////////////////////////////////////
+
+    auto
+    operator++() noexcept -> utf8_decoding_iterator& {
+        return this->advance_(), *this;
+    }
+
+    auto
+    operator++(int) noexcept -> utf8_decoding_iterator {
+        auto r = *this;
+        return this->advance_(), r;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Comparison operator.
+    ////////////////////////////////////////////////////////////////////////////
+
+    friend auto
+    operator==(utf8_decoding_iterator const& i, std::default_sentinel_t)
+        -> bool {
+        return i.is_end_;
+    }
+
+private:
+    // Decodes the next code point.
+    void
+    advance_() noexcept;
+
+    // Remaining part of the string, and the current code point.
+    std::u8string_view string_;
+    char32_t x_{};
+    bool is_end_{true};
+};
+
+// Returns a range of code points of the given UTF-8 encoded string.
+inline auto
+decode_utf8(std::u8string_view string) {
+    return std::ranges::subrange{
+        utf8_decoding_iterator{string}, std::default_sentinel};
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// UTF-32 encoded Unicode string buffer. The buffer is meant to be reused
+// between conversions, so that its memory is allocated once.
 ////////////////////////////////////////////////////////////////////////////////
 
 struct utf32_string_buffer {
@@ -28,27 +109,35 @@ struct utf32_string_buffer {
     ////////////////////////////////////////////////////////////////////////////
 
     operator std::span<char32_t>() noexcept {
-        return std::span{data, size};
+        return this->data;
     }
 
     operator std::span<char32_t const>() const noexcept {
-        return std::span{data, size};
+        return this->data;
     }
 
     ////////////////////////////////////////////////////////////////////////////
     // Data members.
     ////////////////////////////////////////////////////////////////////////////
 
-    char32_t data[255];
-    size_t size;
+    std::u32string data;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
 // String conversion interface.
 ////////////////////////////////////////////////////////////////////////////////
 
+// Writes the converted string to the given range, and returns the number of
+// written code points. Conversion stops when the range is full.
+// Note: The resulting string is in logical order.
 auto
-convert_utf8_to_utf32(std::u8string_view string) -> utf32_string_buffer;
+convert_utf8_to_utf32(std::u8string_view string, std::span<char32_t> result)
+    -> size_t;
+
+// Replaces the contents of the given buffer with the converted string.
+// Note: The resulting string is in logical order.
+void
+convert_utf8_to_utf32(std::u8string_view string, utf32_string_buffer& result);
 
 } // namespace rose
 